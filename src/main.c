@@ -6,8 +6,27 @@ R. Baltrusch
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHESS_HAS_AVX2_TARGET
+#include <immintrin.h>
+#endif
+
 #include "main.h"
 
 int chess_generate_random_number(const int start, const int end)
@@ -16,11 +35,14 @@ int chess_generate_random_number(const int start, const int end)
 }
 
 /*
-Initialises the supplied board with the standard piece configuration.
-It accepts a FEN-notation string; however, it is currently ignored.
+Initialises the supplied board with the standard piece configuration,
+or with the piece placement of the supplied FEN-notation string if it is not empty.
 */
 chess_error_code chess_init_board(int board[BOARD_SIZE], const char string[])
 {
+    if (NULL != string && string[0] != '\0')
+        return chess_init_board_from_fen(board, string);
+
     int initial_board[BOARD_SIZE] = {
         BLACK_ROOK_CASTLE, BLACK_KNIGHT, BLACK_BISHOP, BLACK_QUEEN, BLACK_KING_CASTLE, BLACK_BISHOP, BLACK_KNIGHT, BLACK_ROOK_CASTLE,
         BLACK_PAWN, BLACK_PAWN, BLACK_PAWN, BLACK_PAWN, BLACK_PAWN, BLACK_PAWN, BLACK_PAWN, BLACK_PAWN,
@@ -78,6 +100,126 @@ bool chess_check_board_coordinates_out_of_range(const int x, const int y)
     return (x < 0 || x >= BOARD_ROW_SIZE || y < 0 || y >= BOARD_ROW_SIZE);
 }
 
+// Returns the board piece of a FEN piece character, or EMPTY if the character is not a piece.
+int chess_convert_from_fen_piece(const char character)
+{
+    switch (character)
+    {
+    case 'P':
+        return WHITE_PAWN;
+    case 'R':
+        return WHITE_ROOK;
+    case 'N':
+        return WHITE_KNIGHT;
+    case 'B':
+        return WHITE_BISHOP;
+    case 'Q':
+        return WHITE_QUEEN;
+    case 'K':
+        return WHITE_KING;
+    case 'p':
+        return BLACK_PAWN;
+    case 'r':
+        return BLACK_ROOK;
+    case 'n':
+        return BLACK_KNIGHT;
+    case 'b':
+        return BLACK_BISHOP;
+    case 'q':
+        return BLACK_QUEEN;
+    case 'k':
+        return BLACK_KING;
+    default:
+        return EMPTY;
+    }
+}
+
+/*
+Gives the king and rook of a FEN castling availability character their castling rights,
+if both are on their initial squares. Other characters are ignored.
+*/
+void chess_set_fen_castling_right(int board[BOARD_SIZE], const char character)
+{
+    bool is_white = 'K' == character || 'Q' == character;
+    int row_start = is_white ? BOARD_SIZE - BOARD_ROW_SIZE : 0;
+    int rook_index;
+    switch (character)
+    {
+    case 'K':
+    case 'k':
+        rook_index = row_start + BOARD_ROW_SIZE - 1;
+        break;
+    case 'Q':
+    case 'q':
+        rook_index = row_start;
+        break;
+    default:
+        return;
+    }
+
+    // the king starts on the e-file
+    int king_index = row_start + 4;
+    int king = is_white ? WHITE_KING : BLACK_KING;
+    int rook = is_white ? WHITE_ROOK : BLACK_ROOK;
+    if ((king != board[king_index] && king + 1 != board[king_index]) || (rook != board[rook_index] && rook + 1 != board[rook_index]))
+        return;
+
+    // the castling variant of each piece directly follows the plain one
+    board[king_index] = king + 1;
+    board[rook_index] = rook + 1;
+}
+
+/*
+Initialises the supplied board from the piece placement and castling availability fields of a FEN-notation string.
+The remaining fields are ignored, so no en passant pawns are set.
+*/
+chess_error_code chess_init_board_from_fen(int board[BOARD_SIZE], const char string[])
+{
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        board[i] = EMPTY;
+    }
+
+    int x = 0;
+    int y = 0;
+    int i = 0;
+    for (; i < FEN_MAX_STRING_LENGTH && string[i] != '\0' && string[i] != ' '; i++)
+    {
+        char character = string[i];
+        if ('/' == character)
+        {
+            x = 0;
+            y++;
+            continue;
+        }
+
+        if (character >= '1' && character <= '8')
+        {
+            x += character - '0';
+            continue;
+        }
+
+        int piece = chess_convert_from_fen_piece(character);
+        if (EMPTY == piece || chess_check_board_coordinates_out_of_range(x, y))
+        {
+            chess_log_message("Invalid FEN string supplied!", ERROR);
+            return 1;
+        }
+        board[chess_convert_from_board_coordinates(x, y)] = piece;
+        x++;
+    }
+
+    // skip the side to move, the castling availability field follows it
+    for (int fields = 0; i < FEN_MAX_STRING_LENGTH && string[i] != '\0' && fields < 2; i++)
+    {
+        if (' ' == string[i])
+            fields++;
+    }
+    for (; i < FEN_MAX_STRING_LENGTH && string[i] != '\0' && string[i] != ' '; i++)
+        chess_set_fen_castling_right(board, string[i]);
+    return 0;
+}
+
 // Returns 1 if move origin or destination are out of range, otherwise 0
 bool chess_check_move_out_of_range(const chess_Move *move)
 {
@@ -142,8 +284,25 @@ chess_error_code chess_print_board(const int board[BOARD_SIZE])
     return 0;
 }
 
+// Returns the piece without its castling right, i.e. the plain rook or king of a castling rook or king.
+int chess_remove_castling_right(const int piece)
+{
+    switch (piece)
+    {
+    case WHITE_ROOK_CASTLE:
+    case WHITE_KING_CASTLE:
+    case BLACK_ROOK_CASTLE:
+    case BLACK_KING_CASTLE:
+        return piece - 1;
+    default:
+        return piece;
+    }
+}
+
 /*
 Updates the board with the supplied move.
+A castling king or rook loses its castling right when moved; a king moving CASTLING_OFFSET squares
+castles, moving the rook of that side next to it.
 */
 chess_error_code chess_update_board_with_move(int board[BOARD_SIZE], chess_Move *move)
 {
@@ -153,11 +312,19 @@ chess_error_code chess_update_board_with_move(int board[BOARD_SIZE], chess_Move
         return 1;
     }
 
+    int piece = board[move->origin];
+    if ((WHITE_KING_CASTLE == piece || BLACK_KING_CASTLE == piece) && abs(move->destination - move->origin) == CASTLING_OFFSET)
+    {
+        int row_start = move->origin - move->origin % BOARD_ROW_SIZE;
+        int rook_index = move->destination > move->origin ? row_start + BOARD_ROW_SIZE - 1 : row_start;
+        board[(move->origin + move->destination) / 2] = chess_remove_castling_right(board[rook_index]);
+        board[rook_index] = EMPTY;
+    }
+
     // regular move
-    board[move->destination] = board[move->origin];
+    board[move->destination] = chess_remove_castling_right(piece);
     board[move->origin] = EMPTY;
 
-    // TODO account for castling
     // TODO account for en-passant
     // TODO account for promotion
     return 0;
@@ -227,6 +394,7 @@ chess_error_code chess_free_moves(chess_MovesLinkedList *moves)
         free(current_node);
         current_node = next_node;
     }
+    return 0;
 }
 
 chess_Move *chess_get_move(chess_MovesLinkedList *moves, const int index)
@@ -268,12 +436,16 @@ chess_error_code _chess_compute_offset_move(const int board[BOARD_SIZE], const i
     return 0;
 }
 
-chess_error_code chess_compute_offset_array_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker, const chess_Coordinates offsets[INDEX_OFFSETS])
+// Appends the moves to all precomputed targets of board_index that are not occupied by the own team.
+chess_error_code chess_compute_leaper_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker, const int8_t targets[BOARD_SIZE][LEAPER_TARGETS])
 {
-    chess_Coordinates current = chess_convert_to_board_coordinates(board_index);
-    for (int i = 0; i < INDEX_OFFSETS; i++)
+    for (int i = 0; targets[board_index][i] != LEAPER_TARGETS_END; i++)
     {
-        chess_error_code error_code = _chess_compute_offset_move(board, board_index, moves, checker, offsets[i], false);
+        int new_board_index = targets[board_index][i];
+        if ((*(checker))(board[new_board_index]))
+            continue;
+
+        chess_error_code error_code = chess_append_move(moves, chess_create_move(board_index, new_board_index));
         if (error_code)
             return error_code;
     }
@@ -370,7 +542,7 @@ chess_error_code chess_compute_white_en_passant_moves(const int board[BOARD_SIZE
 
 chess_error_code chess_compute_knight_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker)
 {
-    return chess_compute_offset_array_moves(board, board_index, moves, checker, KNIGHT_MOVE_INDEX_OFFSETS);
+    return chess_compute_leaper_moves(board, board_index, moves, checker, KNIGHT_TARGETS);
 }
 
 chess_error_code chess_compute_backward_line_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker, const int offset)
@@ -392,12 +564,13 @@ chess_error_code chess_compute_backward_line_moves(const int board[BOARD_SIZE],
         if (piece != EMPTY)
             break;
     }
+    return 0;
 }
 
 chess_error_code chess_compute_forward_line_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker, const int offset)
 {
     int current_board_index = board_index;
-    while (current_board_index <= BOARD_SIZE - offset)
+    while (current_board_index < BOARD_SIZE - offset)
     {
         current_board_index += offset;
         int piece = board[current_board_index];
@@ -413,6 +586,7 @@ chess_error_code chess_compute_forward_line_moves(const int board[BOARD_SIZE], c
         if (piece != EMPTY)
             break;
     }
+    return 0;
 }
 
 chess_error_code chess_compute_arbitrary_offset_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker, const chess_Coordinates offset)
@@ -459,7 +633,7 @@ chess_error_code chess_compute_straight_moves(const int board[BOARD_SIZE], const
 chess_error_code chess_compute_diagonal_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker)
 {
     // TODO: check for discovered check
-    int error_code;
+    int error_code = 0;
     for (int i = 0; i < DIAGONAL_MOVES; i++)
     {
         error_code += chess_compute_arbitrary_offset_moves(board, board_index, moves, checker, DIAGONAL_MOVE_INDEX_OFFSETS[i]);
@@ -471,7 +645,7 @@ chess_error_code chess_compute_diagonal_moves(const int board[BOARD_SIZE], const
 chess_error_code chess_compute_king_moves(const int board[BOARD_SIZE], const int board_index, chess_MovesLinkedList *moves, chess_TeamChecker checker)
 {
     // TODO: check for check
-    return chess_compute_offset_array_moves(board, board_index, moves, checker, KING_MOVE_INDEX_OFFSETS);
+    return chess_compute_leaper_moves(board, board_index, moves, checker, KING_TARGETS);
 }
 
 bool _chess_check_castle_side(const int board[BOARD_SIZE], const int start, const int end)
@@ -498,7 +672,8 @@ chess_error_code chess_compute_black_king_castle_moves(const int board[BOARD_SIZ
     }
 
     // king side
-    if (BLACK_ROOK_CASTLE == board[BOARD_ROW_SIZE] && _chess_check_castle_side(board, board_index + 1, BOARD_ROW_SIZE))
+    const int king_side_rook_index = BOARD_ROW_SIZE - 1;
+    if (BLACK_ROOK_CASTLE == board[king_side_rook_index] && _chess_check_castle_side(board, board_index + 1, king_side_rook_index))
     {
         chess_Move *move = chess_create_move(board_index, board_index + CASTLING_OFFSET);
         chess_error_code error_code = chess_append_move(moves, move);
@@ -514,7 +689,7 @@ chess_error_code chess_compute_white_king_castle_moves(const int board[BOARD_SIZ
 
     // queen side
     const int queen_side_rook_index = BOARD_SIZE - BOARD_ROW_SIZE;
-    if (BLACK_ROOK_CASTLE == board[queen_side_rook_index] && _chess_check_castle_side(board, queen_side_rook_index + 1, board_index))
+    if (WHITE_ROOK_CASTLE == board[queen_side_rook_index] && _chess_check_castle_side(board, queen_side_rook_index + 1, board_index))
     {
         chess_Move *move = chess_create_move(board_index, board_index - CASTLING_OFFSET);
         chess_error_code error_code = chess_append_move(moves, move);
@@ -523,7 +698,8 @@ chess_error_code chess_compute_white_king_castle_moves(const int board[BOARD_SIZ
     }
 
     // king side
-    if (BLACK_ROOK_CASTLE == board[BOARD_SIZE] && _chess_check_castle_side(board, board_index + 1, BOARD_SIZE))
+    const int king_side_rook_index = BOARD_SIZE - 1;
+    if (WHITE_ROOK_CASTLE == board[king_side_rook_index] && _chess_check_castle_side(board, board_index + 1, king_side_rook_index))
     {
         chess_Move *move = chess_create_move(board_index, board_index + CASTLING_OFFSET);
         chess_error_code error_code = chess_append_move(moves, move);
@@ -621,23 +797,2135 @@ chess_error_code chess_compute_white_moves(const int board[BOARD_SIZE], chess_Mo
     return 0;
 }
 
-//
-void log_moves(chess_MovesLinkedList *moves)
+void _chess_write_uint16(uint8_t *buffer, const uint16_t value)
 {
-    if (NULL == moves)
-        return;
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
 
-    chess_MovesLinkedListNode *node = moves->head;
-    while (node != NULL)
+uint16_t _chess_read_uint16(const uint8_t *buffer)
+{
+    return buffer[0] | (uint16_t)buffer[1] << 8;
+}
+
+void _chess_write_uint32(uint8_t *buffer, const uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        buffer[i] = (value >> (8 * i)) & 0xFF;
+}
+
+uint32_t _chess_read_uint32(const uint8_t *buffer)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)buffer[i] << (8 * i);
+    return value;
+}
+
+// FNV-1a hash of the block payload, so the reader can tell real blocks from torn ones or stray magic numbers.
+uint32_t _chess_compute_packed_checksum(const uint8_t *buffer, const size_t size)
+{
+    uint32_t checksum = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        checksum = (checksum ^ buffer[i]) * 16777619u;
+    return checksum;
+}
+
+/*
+Encodes the supplied board, side to move and clocks into a compact 28-byte packed position.
+Returns 1 if the board holds an invalid piece value or more than PACKED_MAX_PIECES pieces,
+or if a clock does not fit its field.
+*/
+chess_error_code chess_encode_packed_position(const int board[BOARD_SIZE], const chess_Team team, const int halfmove_clock, const int fullmove_number, chess_PackedPosition *position)
+{
+    if (halfmove_clock < 0 || halfmove_clock > UINT8_MAX || fullmove_number < 0 || fullmove_number > UINT16_MAX)
     {
-        chess_Move *move = node->move;
-        printf("Move from %i to %i\n", move->origin, move->destination);
-        node = node->next_node;
+        chess_log_message("Clocks cannot be packed!", ERROR);
+        return 1;
+    }
+
+    uint64_t occupancy = 0;
+    int piece_count = 0;
+    uint8_t flags = chess_BLACK == team ? PACKED_FLAG_BLACK_TO_MOVE : 0;
+    memset(position->pieces, 0, sizeof(position->pieces));
+
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        int piece = board[i];
+        if (EMPTY == piece)
+            continue;
+
+        if (piece < EMPTY || piece > BLACK_KING_CASTLE || piece_count >= PACKED_MAX_PIECES)
+        {
+            chess_log_message("Board cannot be packed!", ERROR);
+            return 1;
+        }
+
+        if (WHITE_KING_CASTLE == piece)
+            flags |= PACKED_FLAG_WHITE_KING_CASTLE;
+        else if (BLACK_KING_CASTLE == piece)
+            flags |= PACKED_FLAG_BLACK_KING_CASTLE;
+
+        occupancy |= (uint64_t)1 << i;
+        position->pieces[piece_count / 2] |= PACKED_CODES_BY_PIECE[piece] << (4 * (piece_count % 2));
+        piece_count++;
+    }
+
+    for (int i = 0; i < 8; i++)
+        position->occupancy[i] = (occupancy >> (8 * i)) & 0xFF;
+    position->flags = flags;
+    position->halfmove_clock = halfmove_clock;
+    position->fullmove_number = fullmove_number;
+    return 0;
+}
+
+/*
+Decodes a packed position back into the supplied board, side to move and clocks.
+Any of team, halfmove_clock and fullmove_number may be NULL if not needed.
+*/
+chess_error_code chess_decode_packed_position(const chess_PackedPosition *position, int board[BOARD_SIZE], chess_Team *team, int *halfmove_clock, int *fullmove_number)
+{
+    uint64_t occupancy = 0;
+    for (int i = 0; i < 8; i++)
+        occupancy |= (uint64_t)position->occupancy[i] << (8 * i);
+    memset(board, EMPTY, BOARD_SIZE * sizeof(int));
+
+    int piece_count = 0;
+    while (occupancy)
+    {
+        if (piece_count >= PACKED_MAX_PIECES)
+        {
+            chess_log_message("Packed position holds too many pieces!", ERROR);
+            return 1;
+        }
+
+        int index = __builtin_ctzll(occupancy);
+        occupancy &= occupancy - 1;
+        int code = (position->pieces[piece_count / 2] >> (4 * (piece_count % 2))) & 0xF;
+        int piece = PIECES_BY_PACKED_CODE[code];
+        if (WHITE_KING == piece && (position->flags & PACKED_FLAG_WHITE_KING_CASTLE))
+            piece = WHITE_KING_CASTLE;
+        else if (BLACK_KING == piece && (position->flags & PACKED_FLAG_BLACK_KING_CASTLE))
+            piece = BLACK_KING_CASTLE;
+
+        board[index] = piece;
+        piece_count++;
+    }
+
+    if (NULL != team)
+        *team = (position->flags & PACKED_FLAG_BLACK_TO_MOVE) ? chess_BLACK : chess_WHITE;
+    if (NULL != halfmove_clock)
+        *halfmove_clock = position->halfmove_clock;
+    if (NULL != fullmove_number)
+        *fullmove_number = position->fullmove_number;
+    return 0;
+}
+
+/*
+Writes the record in the little-endian file layout: occupancy, pieces, flags, halfmove clock,
+fullmove number, score, result and the reserved byte.
+*/
+void _chess_serialize_packed_record(const chess_PackedRecord *record, uint8_t bytes[PACKED_RECORD_SIZE])
+{
+    const chess_PackedPosition *position = &record->position;
+    memcpy(bytes, position->occupancy, sizeof(position->occupancy));
+    memcpy(bytes + 8, position->pieces, sizeof(position->pieces));
+    bytes[24] = position->flags;
+    bytes[25] = position->halfmove_clock;
+    _chess_write_uint16(bytes + 26, position->fullmove_number);
+    _chess_write_uint16(bytes + 28, (uint16_t)record->score);
+    bytes[30] = (uint8_t)record->result;
+    bytes[31] = record->reserved;
+}
+
+void _chess_deserialize_packed_record(const uint8_t bytes[PACKED_RECORD_SIZE], chess_PackedRecord *record)
+{
+    chess_PackedPosition *position = &record->position;
+    memcpy(position->occupancy, bytes, sizeof(position->occupancy));
+    memcpy(position->pieces, bytes + 8, sizeof(position->pieces));
+    position->flags = bytes[24];
+    position->halfmove_clock = bytes[25];
+    position->fullmove_number = _chess_read_uint16(bytes + 26);
+    record->score = (int16_t)_chess_read_uint16(bytes + 28);
+    record->result = (int8_t)bytes[30];
+    record->reserved = bytes[31];
+}
+
+/*
+Compresses a block of records into buffer and returns the number of bytes written.
+Each record is XORed with its predecessor (consecutive self-play positions differ in few bytes)
+and stored as a 32-bit mask of the non-zero XOR bytes followed by those bytes.
+The buffer must hold at least length * (PACKED_RECORD_MASK_SIZE + PACKED_RECORD_SIZE) bytes.
+*/
+size_t _chess_compress_packed_records(const chess_PackedRecord *records, const int length, uint8_t *buffer)
+{
+    uint8_t previous[PACKED_RECORD_SIZE] = {0};
+    size_t size = 0;
+    for (int i = 0; i < length; i++)
+    {
+        uint8_t current[PACKED_RECORD_SIZE];
+        _chess_serialize_packed_record(&records[i], current);
+        uint8_t *mask_buffer = buffer + size;
+        size += PACKED_RECORD_MASK_SIZE;
+
+        uint32_t mask = 0;
+        for (int j = 0; j < PACKED_RECORD_SIZE; j++)
+        {
+            uint8_t delta = current[j] ^ previous[j];
+            if (delta)
+            {
+                mask |= (uint32_t)1 << j;
+                buffer[size++] = delta;
+            }
+        }
+        _chess_write_uint32(mask_buffer, mask);
+        memcpy(previous, current, PACKED_RECORD_SIZE);
+    }
+    return size;
+}
+
+// Reverses _chess_compress_packed_records. Returns 1 if the block is truncated.
+chess_error_code _chess_decompress_packed_records(const uint8_t *buffer, const size_t size, chess_PackedRecord *records, const int length)
+{
+    uint8_t previous[PACKED_RECORD_SIZE] = {0};
+    size_t offset = 0;
+    for (int i = 0; i < length; i++)
+    {
+        if (offset + PACKED_RECORD_MASK_SIZE > size)
+            return 1;
+
+        uint32_t mask = _chess_read_uint32(buffer + offset);
+        offset += PACKED_RECORD_MASK_SIZE;
+        for (int j = 0; j < PACKED_RECORD_SIZE; j++)
+        {
+            if (mask & ((uint32_t)1 << j))
+            {
+                if (offset >= size)
+                    return 1;
+                previous[j] ^= buffer[offset++];
+            }
+        }
+        _chess_deserialize_packed_record(previous, &records[i]);
+    }
+    return offset == size ? 0 : 1;
+}
+
+/*
+Opens the packed record file at path for appending, creating it if it does not exist.
+Every block is written with a single unbuffered write on an O_APPEND descriptor, so the blocks of
+several writers on a local file system do not interleave; a block torn by a crash is skipped by readers.
+Returns NULL if the file cannot be opened.
+*/
+chess_PackedRecordWriter *chess_open_packed_record_writer(const char path[])
+{
+#ifdef _WIN32
+    int file_descriptor = _open(path, _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int file_descriptor = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+    if (file_descriptor < 0)
+    {
+        chess_log_message("Could not open packed record file for writing!", ERROR);
+        return NULL;
+    }
+
+    chess_PackedRecordWriter *writer = malloc(sizeof(chess_PackedRecordWriter));
+    writer->file_descriptor = file_descriptor;
+    writer->length = 0;
+    return writer;
+}
+
+// Compresses the buffered records and writes them to the file as a single block. On failure the records stay buffered.
+chess_error_code chess_flush_packed_record_writer(chess_PackedRecordWriter *writer)
+{
+    if (NULL == writer)
+        return 1;
+    if (0 == writer->length)
+        return 0;
+
+    uint8_t *buffer = malloc(PACKED_BLOCK_HEADER_SIZE + writer->length * (PACKED_RECORD_MASK_SIZE + PACKED_RECORD_SIZE));
+    size_t size = _chess_compress_packed_records(writer->records, writer->length, buffer + PACKED_BLOCK_HEADER_SIZE);
+    _chess_write_uint32(buffer, PACKED_BLOCK_MAGIC);
+    _chess_write_uint32(buffer + 4, writer->length);
+    _chess_write_uint32(buffer + 8, size);
+    _chess_write_uint32(buffer + 12, _chess_compute_packed_checksum(buffer + PACKED_BLOCK_HEADER_SIZE, size));
+
+    size_t total_size = PACKED_BLOCK_HEADER_SIZE + size;
+#ifdef _WIN32
+    chess_error_code error_code = _write(writer->file_descriptor, buffer, total_size) != (int)total_size;
+#else
+    chess_error_code error_code = write(writer->file_descriptor, buffer, total_size) != (ssize_t)total_size;
+#endif
+    free(buffer);
+    if (error_code)
+    {
+        chess_log_message("Could not write packed record block!", ERROR);
+        return error_code;
+    }
+
+    writer->length = 0;
+    return 0;
+}
+
+/*
+Buffers the record, first writing out the buffered block if it is full.
+Returns the error of that write, in which case the record is not appended.
+*/
+chess_error_code chess_append_packed_record(chess_PackedRecordWriter *writer, const chess_PackedRecord *record)
+{
+    if (NULL == writer || NULL == record)
+        return 1;
+
+    if (writer->length >= PACKED_BLOCK_RECORDS)
+    {
+        chess_error_code error_code = chess_flush_packed_record_writer(writer);
+        if (error_code)
+            return error_code;
+    }
+
+    writer->records[writer->length] = *record;
+    writer->length++;
+    return 0;
+}
+
+// Flushes any buffered records, closes the file and frees the writer.
+chess_error_code chess_close_packed_record_writer(chess_PackedRecordWriter *writer)
+{
+    if (NULL == writer)
+        return 0;
+
+    chess_error_code error_code = chess_flush_packed_record_writer(writer);
+#ifdef _WIN32
+    error_code += _close(writer->file_descriptor) != 0;
+#else
+    error_code += close(writer->file_descriptor) != 0;
+#endif
+    free(writer);
+    return error_code;
+}
+
+/*
+Memory-maps the packed record file at path for reading.
+Returns NULL if the file cannot be opened or mapped.
+*/
+chess_PackedRecordReader *chess_open_packed_record_reader(const char path[])
+{
+    chess_PackedRecordReader *reader = malloc(sizeof(chess_PackedRecordReader));
+    reader->data = NULL;
+    reader->size = 0;
+    reader->offset = 0;
+    reader->length = 0;
+    reader->index = 0;
+
+#ifdef _WIN32
+    reader->mapping_handle = NULL;
+    reader->file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER file_size;
+    if (INVALID_HANDLE_VALUE == reader->file_handle || !GetFileSizeEx(reader->file_handle, &file_size))
+    {
+        chess_log_message("Could not open packed record file for reading!", ERROR);
+        if (INVALID_HANDLE_VALUE != reader->file_handle)
+            CloseHandle(reader->file_handle);
+        free(reader);
+        return NULL;
+    }
+
+    reader->size = file_size.QuadPart;
+    if (reader->size > 0)
+    {
+        reader->mapping_handle = CreateFileMappingA(reader->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        reader->data = NULL == reader->mapping_handle ? NULL : MapViewOfFile(reader->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int file_descriptor = open(path, O_RDONLY);
+    struct stat file_status;
+    if (file_descriptor < 0 || fstat(file_descriptor, &file_status) != 0)
+    {
+        chess_log_message("Could not open packed record file for reading!", ERROR);
+        if (file_descriptor >= 0)
+            close(file_descriptor);
+        free(reader);
+        return NULL;
+    }
+
+    reader->size = file_status.st_size;
+    if (reader->size > 0)
+    {
+        void *data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        reader->data = MAP_FAILED == data ? NULL : data;
+    }
+    close(file_descriptor);
+#endif
+
+    if (reader->size > 0 && NULL == reader->data)
+    {
+        chess_log_message("Could not memory-map packed record file!", ERROR);
+        reader->size = 0;
+    }
+    return reader;
+}
+
+// Returns whether a complete, intact block starts at offset, decoding it into the reader if so.
+bool _chess_decode_packed_record_block(chess_PackedRecordReader *reader, const size_t offset)
+{
+    const uint8_t *header = reader->data + offset;
+    if (offset + PACKED_BLOCK_HEADER_SIZE > reader->size || PACKED_BLOCK_MAGIC != _chess_read_uint32(header))
+        return false;
+
+    uint32_t length = _chess_read_uint32(header + 4);
+    uint32_t size = _chess_read_uint32(header + 8);
+    if (length > PACKED_BLOCK_RECORDS || size > reader->size - offset - PACKED_BLOCK_HEADER_SIZE)
+        return false;
+
+    const uint8_t *payload = header + PACKED_BLOCK_HEADER_SIZE;
+    if (_chess_compute_packed_checksum(payload, size) != _chess_read_uint32(header + 12) ||
+        _chess_decompress_packed_records(payload, size, reader->records, length))
+        return false;
+
+    reader->offset = offset + PACKED_BLOCK_HEADER_SIZE + size;
+    reader->length = length;
+    reader->index = 0;
+    return true;
+}
+
+/*
+Decodes the next block of the mapped file into the reader. Torn or corrupt blocks are skipped by scanning
+forward for the next intact block. Returns 1 at the end of the file.
+*/
+chess_error_code _chess_read_packed_record_block(chess_PackedRecordReader *reader)
+{
+    for (size_t offset = reader->offset; offset + PACKED_BLOCK_HEADER_SIZE <= reader->size; offset++)
+    {
+        if (_chess_decode_packed_record_block(reader, offset))
+            return 0;
+        if (offset == reader->offset)
+            chess_log_message("Skipping corrupt packed record block!", WARNING);
+    }
+
+    reader->offset = reader->size;
+    return 1;
+}
+
+/*
+Copies the next record of the file into record.
+Returns false once the end of the file is reached.
+*/
+bool chess_read_packed_record(chess_PackedRecordReader *reader, chess_PackedRecord *record)
+{
+    if (NULL == reader || NULL == record)
+        return false;
+
+    while (reader->index >= reader->length)
+    {
+        if (_chess_read_packed_record_block(reader))
+            return false;
+    }
+
+    *record = reader->records[reader->index];
+    reader->index++;
+    return true;
+}
+
+// Unmaps the file and frees the reader.
+chess_error_code chess_close_packed_record_reader(chess_PackedRecordReader *reader)
+{
+    if (NULL == reader)
+        return 0;
+
+#ifdef _WIN32
+    if (NULL != reader->data)
+        UnmapViewOfFile(reader->data);
+    if (NULL != reader->mapping_handle)
+        CloseHandle(reader->mapping_handle);
+    CloseHandle(reader->file_handle);
+#else
+    if (NULL != reader->data)
+        munmap((void *)reader->data, reader->size);
+#endif
+    free(reader);
+    return 0;
+}
+
+// Allocates a batch of length positions, with all bitboards cleared.
+chess_BoardBatch *chess_create_board_batch(const int length)
+{
+    chess_BoardBatch *batch = malloc(sizeof(chess_BoardBatch));
+    batch->length = length;
+    for (int team = 0; team < BITBOARD_TEAMS; team++)
+    {
+        for (int type = 0; type < BITBOARD_PIECE_TYPES; type++)
+            batch->bitboards[team][type] = calloc(length, sizeof(uint64_t));
+        batch->attacks[team] = calloc(length, sizeof(uint64_t));
+        batch->move_counts[team] = calloc(length, sizeof(uint32_t));
+    }
+    return batch;
+}
+
+chess_error_code chess_free_board_batch(chess_BoardBatch *batch)
+{
+    if (NULL == batch)
+        return 0;
+
+    for (int team = 0; team < BITBOARD_TEAMS; team++)
+    {
+        for (int type = 0; type < BITBOARD_PIECE_TYPES; type++)
+            free(batch->bitboards[team][type]);
+        free(batch->attacks[team]);
+        free(batch->move_counts[team]);
+    }
+    free(batch);
+    return 0;
+}
+
+// Returns the bitboard piece type of a non-empty board piece, or -1 if the piece value is invalid.
+int chess_get_piece_type(const int piece)
+{
+    switch (piece)
+    {
+    case WHITE_PAWN:
+    case WHITE_PAWN_EN_PASSANT:
+    case BLACK_PAWN:
+    case BLACK_PAWN_EN_PASSANT:
+        return chess_PAWN;
+    case WHITE_ROOK:
+    case WHITE_ROOK_CASTLE:
+    case BLACK_ROOK:
+    case BLACK_ROOK_CASTLE:
+        return chess_ROOK;
+    case WHITE_KNIGHT:
+    case BLACK_KNIGHT:
+        return chess_KNIGHT;
+    case WHITE_BISHOP:
+    case BLACK_BISHOP:
+        return chess_BISHOP;
+    case WHITE_QUEEN:
+    case BLACK_QUEEN:
+        return chess_QUEEN;
+    case WHITE_KING:
+    case WHITE_KING_CASTLE:
+    case BLACK_KING:
+    case BLACK_KING_CASTLE:
+        return chess_KING;
+    default:
+        return -1;
     }
 }
 
-int main()
+// Stores the supplied board as position index of the batch.
+chess_error_code chess_set_board_batch_position(chess_BoardBatch *batch, const int index, const int board[BOARD_SIZE])
 {
+    if (NULL == batch || index < 0 || index >= batch->length)
+        return 1;
+
+    uint64_t bitboards[BITBOARD_TEAMS][BITBOARD_PIECE_TYPES] = {0};
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        int piece = board[i];
+        if (EMPTY == piece)
+            continue;
+
+        int type = chess_get_piece_type(piece);
+        if (type < 0)
+        {
+            chess_log_message("Invalid piece supplied!", ERROR);
+            return 1;
+        }
+        chess_Team team = chess_is_black(piece) ? chess_BLACK : chess_WHITE;
+        bitboards[team][type] |= (uint64_t)1 << i;
+    }
+
+    for (int team = 0; team < BITBOARD_TEAMS; team++)
+    {
+        for (int type = 0; type < BITBOARD_PIECE_TYPES; type++)
+            batch->bitboards[team][type][index] = bitboards[team][type];
+    }
+    return 0;
+}
+
+uint64_t _chess_shift_bitboard(const uint64_t bitboard, const chess_BitboardDirection direction)
+{
+    uint64_t shifted = direction.shift > 0 ? bitboard << direction.shift : bitboard >> -direction.shift;
+    return shifted & direction.mask;
+}
+
+/*
+Returns all squares reached by sliding the pieces in bitboard along direction until blocked (Kogge-Stone fill).
+The first blocker is included, so the result has to be masked with the non-team squares to obtain moves.
+*/
+uint64_t _chess_compute_line_bitboard(uint64_t bitboard, uint64_t empty, const chess_BitboardDirection direction)
+{
+    chess_BitboardDirection step = direction;
+    empty &= direction.mask;
+    for (int i = 0; i < 3; i++)
+    {
+        bitboard |= empty & _chess_shift_bitboard(bitboard, (chess_BitboardDirection){step.shift, ~0ULL});
+        empty &= _chess_shift_bitboard(empty, (chess_BitboardDirection){step.shift, ~0ULL});
+        step.shift *= 2;
+    }
+    return _chess_shift_bitboard(bitboard, direction);
+}
+
+/*
+Computes the attacked squares and the number of pseudo-legal moves of team in position index of the batch.
+Attacks along a single direction never overlap between pieces of one team, so the move count
+is the sum of the population counts of the per-direction move sets.
+*/
+void _chess_compute_board_batch_team_moves(chess_BoardBatch *batch, const int index, const chess_Team team)
+{
+    uint64_t *const *pieces = batch->bitboards[team];
+    uint64_t *const *enemy_pieces = batch->bitboards[!team];
+    uint64_t team_occupancy = 0;
+    uint64_t enemy_occupancy = 0;
+    for (int type = 0; type < BITBOARD_PIECE_TYPES; type++)
+    {
+        team_occupancy |= pieces[type][index];
+        enemy_occupancy |= enemy_pieces[type][index];
+    }
+    uint64_t empty = ~(team_occupancy | enemy_occupancy);
+
+    uint64_t attacks = 0;
+    int move_count = 0;
+    uint64_t straight = pieces[chess_ROOK][index] | pieces[chess_QUEEN][index];
+    uint64_t diagonal = pieces[chess_BISHOP][index] | pieces[chess_QUEEN][index];
+    for (int i = 0; i < BITBOARD_LINE_DIRECTIONS; i++)
+    {
+        uint64_t line_attacks[4] = {
+            _chess_compute_line_bitboard(straight, empty, STRAIGHT_BITBOARD_DIRECTIONS[i]),
+            _chess_compute_line_bitboard(diagonal, empty, DIAGONAL_BITBOARD_DIRECTIONS[i]),
+            _chess_shift_bitboard(pieces[chess_KING][index], STRAIGHT_BITBOARD_DIRECTIONS[i]),
+            _chess_shift_bitboard(pieces[chess_KING][index], DIAGONAL_BITBOARD_DIRECTIONS[i])};
+        for (int j = 0; j < 4; j++)
+        {
+            attacks |= line_attacks[j];
+            move_count += __builtin_popcountll(line_attacks[j] & ~team_occupancy);
+        }
+    }
+
+    for (int i = 0; i < INDEX_OFFSETS; i++)
+    {
+        uint64_t knight_attacks = _chess_shift_bitboard(pieces[chess_KNIGHT][index], KNIGHT_BITBOARD_DIRECTIONS[i]);
+        attacks |= knight_attacks;
+        move_count += __builtin_popcountll(knight_attacks & ~team_occupancy);
+    }
+
+    const chess_BitboardDirection *captures = chess_WHITE == team ? WHITE_PAWN_CAPTURE_BITBOARD_DIRECTIONS : BLACK_PAWN_CAPTURE_BITBOARD_DIRECTIONS;
+    chess_BitboardDirection push = {chess_WHITE == team ? -BOARD_ROW_SIZE : BOARD_ROW_SIZE, ~0ULL};
+    uint64_t double_push_rank = chess_WHITE == team ? BITBOARD_WHITE_DOUBLE_PUSH_RANK : BITBOARD_BLACK_DOUBLE_PUSH_RANK;
+    uint64_t pawns = pieces[chess_PAWN][index];
+    for (int i = 0; i < 2; i++)
+    {
+        uint64_t pawn_attacks = _chess_shift_bitboard(pawns, captures[i]);
+        attacks |= pawn_attacks;
+        move_count += __builtin_popcountll(pawn_attacks & enemy_occupancy);
+    }
+    uint64_t single_pushes = _chess_shift_bitboard(pawns, push) & empty;
+    uint64_t double_pushes = _chess_shift_bitboard(single_pushes & double_push_rank, push) & empty;
+    move_count += __builtin_popcountll(single_pushes) + __builtin_popcountll(double_pushes);
+
+    batch->attacks[team][index] = attacks;
+    batch->move_counts[team][index] = move_count;
+}
+
+#ifdef CHESS_HAS_AVX2_TARGET
+__attribute__((target("avx2"))) static inline __m256i _chess_shift_bitboards_avx2(const __m256i bitboards, const chess_BitboardDirection direction)
+{
+    __m256i shifted = direction.shift > 0 ? _mm256_sll_epi64(bitboards, _mm_cvtsi32_si128(direction.shift)) : _mm256_srl_epi64(bitboards, _mm_cvtsi32_si128(-direction.shift));
+    return _mm256_and_si256(shifted, _mm256_set1_epi64x(direction.mask));
+}
+
+// Per-lane population count using a nibble lookup table, since AVX2 has no 64-bit popcount instruction.
+__attribute__((target("avx2"))) static inline __m256i _chess_popcount_bitboards_avx2(const __m256i bitboards)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(bitboards, low_mask));
+    __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi64(bitboards, 4), low_mask));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static inline __m256i _chess_compute_line_bitboards_avx2(__m256i bitboards, __m256i empty, const chess_BitboardDirection direction)
+{
+    chess_BitboardDirection step = {direction.shift, ~0ULL};
+    empty = _mm256_and_si256(empty, _mm256_set1_epi64x(direction.mask));
+    for (int i = 0; i < 3; i++)
+    {
+        bitboards = _mm256_or_si256(bitboards, _mm256_and_si256(empty, _chess_shift_bitboards_avx2(bitboards, step)));
+        empty = _mm256_and_si256(empty, _chess_shift_bitboards_avx2(empty, step));
+        step.shift *= 2;
+    }
+    return _chess_shift_bitboards_avx2(bitboards, direction);
+}
+
+// AVX2 version of _chess_compute_board_batch_team_moves for positions index to index + BITBOARD_AVX2_LANES - 1.
+__attribute__((target("avx2"))) void _chess_compute_board_batch_team_moves_avx2(chess_BoardBatch *batch, const int index, const chess_Team team)
+{
+    __m256i pieces[BITBOARD_PIECE_TYPES];
+    __m256i team_occupancy = _mm256_setzero_si256();
+    __m256i enemy_occupancy = _mm256_setzero_si256();
+    for (int type = 0; type < BITBOARD_PIECE_TYPES; type++)
+    {
+        pieces[type] = _mm256_loadu_si256((const __m256i *)(batch->bitboards[team][type] + index));
+        team_occupancy = _mm256_or_si256(team_occupancy, pieces[type]);
+        enemy_occupancy = _mm256_or_si256(enemy_occupancy, _mm256_loadu_si256((const __m256i *)(batch->bitboards[!team][type] + index)));
+    }
+    __m256i empty = _mm256_xor_si256(_mm256_or_si256(team_occupancy, enemy_occupancy), _mm256_set1_epi64x(-1));
+
+    __m256i attacks = _mm256_setzero_si256();
+    __m256i move_counts = _mm256_setzero_si256();
+    __m256i straight = _mm256_or_si256(pieces[chess_ROOK], pieces[chess_QUEEN]);
+    __m256i diagonal = _mm256_or_si256(pieces[chess_BISHOP], pieces[chess_QUEEN]);
+    for (int i = 0; i < BITBOARD_LINE_DIRECTIONS; i++)
+    {
+        __m256i line_attacks[4] = {
+            _chess_compute_line_bitboards_avx2(straight, empty, STRAIGHT_BITBOARD_DIRECTIONS[i]),
+            _chess_compute_line_bitboards_avx2(diagonal, empty, DIAGONAL_BITBOARD_DIRECTIONS[i]),
+            _chess_shift_bitboards_avx2(pieces[chess_KING], STRAIGHT_BITBOARD_DIRECTIONS[i]),
+            _chess_shift_bitboards_avx2(pieces[chess_KING], DIAGONAL_BITBOARD_DIRECTIONS[i])};
+        for (int j = 0; j < 4; j++)
+        {
+            attacks = _mm256_or_si256(attacks, line_attacks[j]);
+            move_counts = _mm256_add_epi64(move_counts, _chess_popcount_bitboards_avx2(_mm256_andnot_si256(team_occupancy, line_attacks[j])));
+        }
+    }
+
+    for (int i = 0; i < INDEX_OFFSETS; i++)
+    {
+        __m256i knight_attacks = _chess_shift_bitboards_avx2(pieces[chess_KNIGHT], KNIGHT_BITBOARD_DIRECTIONS[i]);
+        attacks = _mm256_or_si256(attacks, knight_attacks);
+        move_counts = _mm256_add_epi64(move_counts, _chess_popcount_bitboards_avx2(_mm256_andnot_si256(team_occupancy, knight_attacks)));
+    }
+
+    const chess_BitboardDirection *captures = chess_WHITE == team ? WHITE_PAWN_CAPTURE_BITBOARD_DIRECTIONS : BLACK_PAWN_CAPTURE_BITBOARD_DIRECTIONS;
+    chess_BitboardDirection push = {chess_WHITE == team ? -BOARD_ROW_SIZE : BOARD_ROW_SIZE, ~0ULL};
+    __m256i double_push_rank = _mm256_set1_epi64x(chess_WHITE == team ? BITBOARD_WHITE_DOUBLE_PUSH_RANK : BITBOARD_BLACK_DOUBLE_PUSH_RANK);
+    for (int i = 0; i < 2; i++)
+    {
+        __m256i pawn_attacks = _chess_shift_bitboards_avx2(pieces[chess_PAWN], captures[i]);
+        attacks = _mm256_or_si256(attacks, pawn_attacks);
+        move_counts = _mm256_add_epi64(move_counts, _chess_popcount_bitboards_avx2(_mm256_and_si256(pawn_attacks, enemy_occupancy)));
+    }
+    __m256i single_pushes = _mm256_and_si256(_chess_shift_bitboards_avx2(pieces[chess_PAWN], push), empty);
+    __m256i double_pushes = _mm256_and_si256(_chess_shift_bitboards_avx2(_mm256_and_si256(single_pushes, double_push_rank), push), empty);
+    move_counts = _mm256_add_epi64(move_counts, _chess_popcount_bitboards_avx2(single_pushes));
+    move_counts = _mm256_add_epi64(move_counts, _chess_popcount_bitboards_avx2(double_pushes));
+
+    _mm256_storeu_si256((__m256i *)(batch->attacks[team] + index), attacks);
+    uint64_t lane_move_counts[BITBOARD_AVX2_LANES];
+    _mm256_storeu_si256((__m256i *)lane_move_counts, move_counts);
+    for (int i = 0; i < BITBOARD_AVX2_LANES; i++)
+        batch->move_counts[team][index + i] = lane_move_counts[i];
+}
+#endif
+
+bool chess_has_avx2(void)
+{
+#ifdef CHESS_HAS_AVX2_TARGET
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+/*
+Computes attacks and pseudo-legal move counts of both teams for all positions of the batch.
+If use_avx2 is set and the CPU supports it, uses AVX2 (BITBOARD_AVX2_LANES positions per register),
+falling back to the scalar version otherwise and for the remaining positions.
+*/
+chess_error_code chess_compute_board_batch_moves(chess_BoardBatch *batch, const bool use_avx2)
+{
+    if (NULL == batch)
+        return 1;
+
+    int index = 0;
+#ifdef CHESS_HAS_AVX2_TARGET
+    if (use_avx2 && chess_has_avx2())
+    {
+        for (; index + BITBOARD_AVX2_LANES <= batch->length; index += BITBOARD_AVX2_LANES)
+        {
+            _chess_compute_board_batch_team_moves_avx2(batch, index, chess_WHITE);
+            _chess_compute_board_batch_team_moves_avx2(batch, index, chess_BLACK);
+        }
+    }
+#endif
+
+    for (; index < batch->length; index++)
+    {
+        _chess_compute_board_batch_team_moves(batch, index, chess_WHITE);
+        _chess_compute_board_batch_team_moves(batch, index, chess_BLACK);
+    }
+    return 0;
+}
+
+chess_Team chess_get_opposing_team(const chess_Team team)
+{
+    return chess_WHITE == team ? chess_BLACK : chess_WHITE;
+}
+
+// Returns the squares attacked by team, using a single-position batch on the stack.
+uint64_t chess_compute_team_attacks(const int board[BOARD_SIZE], const chess_Team team)
+{
+    uint64_t bitboards[BITBOARD_TEAMS][BITBOARD_PIECE_TYPES];
+    uint64_t attacks[BITBOARD_TEAMS];
+    uint32_t move_counts[BITBOARD_TEAMS];
+    chess_BoardBatch batch = {.length = 1};
+    for (int i = 0; i < BITBOARD_TEAMS; i++)
+    {
+        for (int type = 0; type < BITBOARD_PIECE_TYPES; type++)
+            batch.bitboards[i][type] = &bitboards[i][type];
+        batch.attacks[i] = &attacks[i];
+        batch.move_counts[i] = &move_counts[i];
+    }
+
+    if (chess_set_board_batch_position(&batch, 0, board))
+        return 0;
+    _chess_compute_board_batch_team_moves(&batch, 0, team);
+    return attacks[team];
+}
+
+bool chess_is_team_in_check(const int board[BOARD_SIZE], const chess_Team team)
+{
+    uint64_t kings = 0;
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        int piece = board[i];
+        if (EMPTY != piece && chess_KING == chess_get_piece_type(piece) && chess_is_black(piece) == (chess_BLACK == team))
+            kings |= (uint64_t)1 << i;
+    }
+    return (kings & chess_compute_team_attacks(board, chess_get_opposing_team(team))) != 0;
+}
+
+chess_error_code chess_compute_team_moves(const int board[BOARD_SIZE], const chess_Team team, chess_MovesLinkedList *moves)
+{
+    return chess_WHITE == team ? chess_compute_white_moves(board, moves) : chess_compute_black_moves(board, moves);
+}
+
+/*
+Appends all moves of team to moves that do not leave its own king in check.
+*/
+chess_error_code chess_compute_legal_moves(const int board[BOARD_SIZE], const chess_Team team, chess_MovesLinkedList *moves)
+{
+    chess_MovesLinkedList *pseudo_legal_moves = &((chess_MovesLinkedList){NULL});
+    chess_error_code error_code = chess_compute_team_moves(board, team, pseudo_legal_moves);
+
+    chess_MovesLinkedListNode *node = pseudo_legal_moves->head;
+    while (node != NULL && !error_code)
+    {
+        int new_board[BOARD_SIZE];
+        memcpy(new_board, board, sizeof(new_board));
+        error_code = chess_update_board_with_move(new_board, node->move);
+        if (!error_code && !chess_is_team_in_check(new_board, team))
+            error_code = chess_append_move(moves, chess_create_move(node->move->origin, node->move->destination));
+        node = node->next_node;
+    }
+    chess_free_moves(pseudo_legal_moves);
+    return error_code;
+}
+
+uint32_t _chess_add_proof_numbers(const uint32_t first, const uint32_t second)
+{
+    return first > PROOF_NUMBER_INFINITY - second ? PROOF_NUMBER_INFINITY : first + second;
+}
+
+bool _chess_is_proof_node_solved(const chess_ProofNode *node)
+{
+    return 0 == node->proof_number || 0 == node->disproof_number;
+}
+
+// Attacker nodes (even plies) are OR nodes, defender nodes (odd plies) are AND nodes.
+bool _chess_is_proof_or_node(const chess_ProofNode *node)
+{
+    return 0 == node->ply % 2;
+}
+
+void _chess_set_proof_node_value(chess_ProofNode *node, const bool proven)
+{
+    node->proof_number = proven ? 0 : PROOF_NUMBER_INFINITY;
+    node->disproof_number = proven ? PROOF_NUMBER_INFINITY : 0;
+}
+
+int _chess_allocate_proof_node(chess_ProofSearch *search, const int parent, const int ply)
+{
+    // take freed nodes first, so the pool is only touched up to its high-water mark
+    int index = search->free_head;
+    if (PROOF_NODE_NONE == index)
+        index = search->peak_nodes++;
+    else
+        search->free_head = search->nodes[index].next_sibling;
+    search->free_count--;
+    search->allocated_nodes++;
+
+    chess_ProofNode *node = &search->nodes[index];
+
+    node->proof_number = 1;
+    node->disproof_number = 1;
+    node->parent = parent;
+    node->first_child = PROOF_NODE_NONE;
+    node->next_sibling = PROOF_NODE_NONE;
+    node->ply = ply;
+    return index;
+}
+
+// Returns the node and all its descendants to the free list.
+void _chess_free_proof_subtree(chess_ProofSearch *search, const int index)
+{
+    int child = search->nodes[index].first_child;
+    while (child != PROOF_NODE_NONE)
+    {
+        int next_sibling = search->nodes[child].next_sibling;
+        _chess_free_proof_subtree(search, child);
+        child = next_sibling;
+    }
+
+    search->nodes[index].next_sibling = search->free_head;
+    search->free_head = index;
+    search->free_count++;
+}
+
+/*
+Frees the subtrees of a solved node that are not part of its proof:
+all children of a disproven node, and all but one proving child of a proven OR node.
+Proven AND nodes keep all their (proven) children.
+*/
+void _chess_collect_solved_proof_node(chess_ProofSearch *search, const int index)
+{
+    chess_ProofNode *node = &search->nodes[index];
+    if (node->proof_number != 0 || _chess_is_proof_or_node(node))
+    {
+        int kept_child = PROOF_NODE_NONE;
+        int child = node->first_child;
+        while (child != PROOF_NODE_NONE)
+        {
+            int next_sibling = search->nodes[child].next_sibling;
+            if (0 == node->proof_number && PROOF_NODE_NONE == kept_child && 0 == search->nodes[child].proof_number)
+                kept_child = child;
+            else
+                _chess_free_proof_subtree(search, child);
+            child = next_sibling;
+        }
+
+        node->first_child = kept_child;
+        if (kept_child != PROOF_NODE_NONE)
+            search->nodes[kept_child].next_sibling = PROOF_NODE_NONE;
+    }
+}
+
+/*
+Generates the children of the node whose position is board.
+Nodes without legal moves are solved directly (proven if the defender is checkmated), as are defender nodes
+on the last ply, which are disproven if the defender can still move.
+Returns 1 if the node pool has no room for the children.
+*/
+chess_error_code _chess_expand_proof_node(chess_ProofSearch *search, const int index, const int board[BOARD_SIZE])
+{
+    chess_ProofNode *node = &search->nodes[index];
+    bool is_or_node = _chess_is_proof_or_node(node);
+    chess_Team team = is_or_node ? search->attacker : chess_get_opposing_team(search->attacker);
+    chess_MovesLinkedList *moves = &((chess_MovesLinkedList){NULL});
+    chess_error_code error_code = chess_compute_legal_moves(board, team, moves);
+    search->expanded_nodes++;
+
+    if (error_code)
+    {
+        chess_free_moves(moves);
+        return error_code;
+    }
+
+    if (0 == moves->length)
+        _chess_set_proof_node_value(node, !is_or_node && chess_is_team_in_check(board, team));
+    else if (!is_or_node && node->ply >= search->max_plies - 1)
+        _chess_set_proof_node_value(node, false);
+    else if (moves->length > search->free_count)
+        error_code = 1;
+    else
+    {
+        int previous_child = PROOF_NODE_NONE;
+        chess_MovesLinkedListNode *move_node = moves->head;
+        while (move_node != NULL)
+        {
+            int child = _chess_allocate_proof_node(search, index, node->ply + 1);
+            search->nodes[child].origin = move_node->move->origin;
+            search->nodes[child].destination = move_node->move->destination;
+            if (PROOF_NODE_NONE == previous_child)
+                node->first_child = child;
+            else
+                search->nodes[previous_child].next_sibling = child;
+            previous_child = child;
+            move_node = move_node->next_node;
+        }
+        node->proof_number = is_or_node ? 1 : moves->length;
+        node->disproof_number = is_or_node ? moves->length : 1;
+    }
+    chess_free_moves(moves);
+    return error_code;
+}
+
+// Recomputes the proof and disproof numbers from the node up to the root, collecting solved subtrees on the way.
+void _chess_update_proof_ancestors(chess_ProofSearch *search, int index)
+{
+    while (index != PROOF_NODE_NONE)
+    {
+        chess_ProofNode *node = &search->nodes[index];
+        if (node->first_child != PROOF_NODE_NONE)
+        {
+            bool is_or_node = _chess_is_proof_or_node(node);
+            uint32_t minimum = PROOF_NUMBER_INFINITY;
+            uint32_t sum = 0;
+            for (int child = node->first_child; child != PROOF_NODE_NONE; child = search->nodes[child].next_sibling)
+            {
+                chess_ProofNode *child_node = &search->nodes[child];
+                uint32_t minimised = is_or_node ? child_node->proof_number : child_node->disproof_number;
+                uint32_t summed = is_or_node ? child_node->disproof_number : child_node->proof_number;
+                if (minimised < minimum)
+                    minimum = minimised;
+                sum = _chess_add_proof_numbers(sum, summed);
+            }
+            node->proof_number = is_or_node ? minimum : sum;
+            node->disproof_number = is_or_node ? sum : minimum;
+        }
+
+        if (_chess_is_proof_node_solved(node))
+            _chess_collect_solved_proof_node(search, index);
+        index = node->parent;
+    }
+}
+
+/*
+Descends from the root to the most-proving node, following the child with the smallest proof number at OR nodes
+and the child with the smallest disproof number at AND nodes, and replays the moves on board.
+*/
+int _chess_select_most_proving_node(chess_ProofSearch *search, int board[BOARD_SIZE])
+{
+    memcpy(board, search->root_board, sizeof(search->root_board));
+    int index = 0;
+    while (search->nodes[index].first_child != PROOF_NODE_NONE)
+    {
+        chess_ProofNode *node = &search->nodes[index];
+        bool is_or_node = _chess_is_proof_or_node(node);
+        int child = node->first_child;
+        while (child != PROOF_NODE_NONE)
+        {
+            chess_ProofNode *child_node = &search->nodes[child];
+            if (is_or_node ? child_node->proof_number == node->proof_number : child_node->disproof_number == node->disproof_number)
+                break;
+            child = child_node->next_sibling;
+        }
+
+        chess_Move move = {search->nodes[child].origin, search->nodes[child].destination};
+        chess_update_board_with_move(board, &move);
+        index = child;
+    }
+    return index;
+}
+
+int _chess_count_proof_subtree(const chess_ProofSearch *search, const int index)
+{
+    int count = 1;
+    for (int child = search->nodes[index].first_child; child != PROOF_NODE_NONE; child = search->nodes[child].next_sibling)
+        count += _chess_count_proof_subtree(search, child);
+    return count;
+}
+
+/*
+Answers whether attacker, being the side to move, can force mate within max_moves of its own moves,
+using proof-number search over a node pool of at most memory_limit bytes.
+The result is chess_MATE_UNKNOWN if the pool runs out before the root is solved.
+*/
+chess_MateSearchReport chess_search_mate(const int board[BOARD_SIZE], const chess_Team attacker, const int max_moves, const size_t memory_limit)
+{
+    clock_t start_time = clock();
+    chess_MateSearchReport report = {.result = chess_MATE_UNKNOWN, .move = {-1, -1}};
+    chess_ProofSearch search = {0};
+    search.capacity = memory_limit / sizeof(chess_ProofNode);
+    search.attacker = attacker;
+    search.max_plies = 2 * max_moves;
+    if (search.capacity < 1 || max_moves < 1)
+        return report;
+
+    search.nodes = malloc(search.capacity * sizeof(chess_ProofNode));
+    search.free_head = PROOF_NODE_NONE;
+    search.free_count = search.capacity;
+    memcpy(search.root_board, board, sizeof(search.root_board));
+
+    _chess_allocate_proof_node(&search, PROOF_NODE_NONE, 0);
+    while (!_chess_is_proof_node_solved(&search.nodes[0]))
+    {
+        int current_board[BOARD_SIZE];
+        int index = _chess_select_most_proving_node(&search, current_board);
+        if (_chess_expand_proof_node(&search, index, current_board))
+        {
+            chess_log_message("Proof-number search ran out of memory!", WARNING);
+            break;
+        }
+        _chess_update_proof_ancestors(&search, index);
+    }
+
+    chess_ProofNode *root = &search.nodes[0];
+    if (_chess_is_proof_node_solved(root))
+        report.result = 0 == root->proof_number ? chess_MATE_FOUND : chess_NO_MATE;
+    if (chess_MATE_FOUND == report.result)
+    {
+        report.move = (chess_Move){search.nodes[root->first_child].origin, search.nodes[root->first_child].destination};
+        report.proof_tree_size = _chess_count_proof_subtree(&search, 0);
+    }
+    report.expanded_nodes = search.expanded_nodes;
+    report.peak_nodes = search.peak_nodes;
+    report.allocated_nodes = search.allocated_nodes;
+    free(search.nodes);
+    report.solve_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
+    return report;
+}
+
+/*
+Solves all MATE_PUZZLES and prints result, proof tree size and solve time.
+Every search has to stay within its node pool. Solved puzzles with their own memory limit also have to allocate
+more nodes over the search than the pool holds, so they only pass if solved subtrees are collected.
+Returns the number of wrong results.
+*/
+int chess_run_mate_puzzle_suite(const size_t memory_limit)
+{
+    const char *result_names[] = {"mate", "no mate", "unknown"};
+    int failures = 0;
+    double total_time = 0;
+    for (int i = 0; i < MATE_PUZZLE_COUNT; i++)
+    {
+        const chess_MatePuzzle *puzzle = &MATE_PUZZLES[i];
+        size_t puzzle_memory_limit = 0 == puzzle->memory_limit ? memory_limit : puzzle->memory_limit;
+        int board[BOARD_SIZE];
+        chess_init_board(board, puzzle->fen);
+        chess_MateSearchReport report = chess_search_mate(board, puzzle->team, puzzle->moves, puzzle_memory_limit);
+        int pool_nodes = puzzle_memory_limit / sizeof(chess_ProofNode);
+        bool is_correct = report.result == puzzle->expected_result && report.peak_nodes <= pool_nodes;
+        if (0 != puzzle->memory_limit && chess_MATE_UNKNOWN != puzzle->expected_result)
+            is_correct = is_correct && report.allocated_nodes > pool_nodes;
+        failures += !is_correct;
+        total_time += report.solve_time;
+        printf("%i: %s (mate in %i, %i node pool): %s, move %i to %i, %i expanded, %i allocated, %i peak nodes, proof tree %i, %.4f s%s\n",
+               i, puzzle->fen, puzzle->moves, pool_nodes, result_names[report.result], report.move.origin, report.move.destination,
+               report.expanded_nodes, report.allocated_nodes, report.peak_nodes, report.proof_tree_size, report.solve_time, is_correct ? "" : " FAILED");
+    }
+    printf("Solved %i of %i mate puzzles correctly in %.4f seconds\n", MATE_PUZZLE_COUNT - failures, MATE_PUZZLE_COUNT, total_time);
+    return failures;
+}
+
+uint64_t _chess_get_zobrist_key(const uint64_t seed)
+{
+    // splitmix64, so the keys need neither a table nor initialisation
+    uint64_t key = seed * 0x9E3779B97F4A7C15ULL + 0x9E3779B97F4A7C15ULL;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+uint64_t chess_compute_zobrist_hash(const int board[BOARD_SIZE], const chess_Team team)
+{
+    uint64_t hash = chess_BLACK == team ? _chess_get_zobrist_key(0) : 0;
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        if (EMPTY != board[i])
+            hash ^= _chess_get_zobrist_key(board[i] * BOARD_SIZE + i + 1);
+    }
+    return hash;
+}
+
+// Returns the material balance from the point of view of white.
+double chess_evaluate_material(const int board[BOARD_SIZE])
+{
+    double score = 0;
+    for (int i = 0; i < BOARD_SIZE; i++)
+        score += PIECE_VALUES[board[i]];
+    return score;
+}
+
+bool chess_is_same_move(const chess_Move *first, const chess_Move *second)
+{
+    return first->origin == second->origin && first->destination == second->destination;
+}
+
+chess_SearchState *chess_create_search_state(const bool persistent)
+{
+    chess_SearchState *state = calloc(1, sizeof(chess_SearchState));
+    state->persistent = persistent;
+    state->transposition_table = calloc(TRANSPOSITION_TABLE_ENTRIES, sizeof(chess_TranspositionEntry));
+    return state;
+}
+
+chess_error_code chess_free_search_state(chess_SearchState *state)
+{
+    if (NULL == state)
+        return 0;
+
+    free(state->transposition_table);
+    free(state);
+    return 0;
+}
+
+/*
+Prepares the state for a search from a new root position, root_plies plies after the root of the previous search.
+Persistent states age their tables; otherwise everything learnt by previous searches is discarded.
+*/
+void _chess_prepare_search_state(chess_SearchState *state, const uint64_t hash, const int root_plies)
+{
+    if (!state->persistent)
+    {
+        memset(state->transposition_table, 0, TRANSPOSITION_TABLE_ENTRIES * sizeof(chess_TranspositionEntry));
+        memset(state->history, 0, sizeof(state->history));
+        memset(state->killers, 0, sizeof(state->killers));
+        state->pv_length = 0;
+        return;
+    }
+
+    state->generation++;
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        for (int j = 0; j < BOARD_SIZE; j++)
+            state->history[i][j] /= 2;
+    }
+
+    // killers are indexed by the ply from the root, so they move along with it
+    memmove(state->killers, state->killers + root_plies, (SEARCH_MAX_PLY - root_plies) * sizeof(state->killers[0]));
+    memset(state->killers + SEARCH_MAX_PLY - root_plies, 0, root_plies * sizeof(state->killers[0]));
+
+    // if both sides played along the previous principal variation, its remainder is the expected line
+    if (hash == state->expected_hash && state->pv_length > 2)
+    {
+        memmove(state->pv, state->pv + 2, (state->pv_length - 2) * sizeof(chess_Move));
+        state->pv_length -= 2;
+    }
+    else
+        state->pv_length = 0;
+}
+
+chess_TranspositionEntry *_chess_probe_transposition_table(chess_SearchState *state, const uint64_t hash)
+{
+    chess_TranspositionEntry *entry = &state->transposition_table[hash % TRANSPOSITION_TABLE_ENTRIES];
+    return entry->hash == hash ? entry : NULL;
+}
+
+// Entries of older generations are always replaced; entries of the current one only by searches at least as deep.
+void _chess_store_transposition_entry(chess_SearchState *state, const uint64_t hash, const int depth, int score, const int ply, const chess_Bound bound, const chess_Move *move)
+{
+    chess_TranspositionEntry *entry = &state->transposition_table[hash % TRANSPOSITION_TABLE_ENTRIES];
+    if (entry->hash != hash && entry->generation == state->generation && entry->depth > depth)
+        return;
+
+    // mate scores are stored relative to the node rather than to the root
+    if (score > SEARCH_MATE_SCORE - SEARCH_MAX_PLY)
+        score += ply;
+    else if (score < -SEARCH_MATE_SCORE + SEARCH_MAX_PLY)
+        score -= ply;
+
+    entry->hash = hash;
+    entry->score = score;
+    entry->depth = depth;
+    entry->bound = bound;
+    entry->generation = state->generation;
+    entry->origin = NULL == move ? -1 : move->origin;
+    entry->destination = NULL == move ? -1 : move->destination;
+}
+
+int _chess_score_search_move(const chess_SearchState *state, const int board[BOARD_SIZE], const chess_Move *move, const chess_Move *transposition_move, const int ply)
+{
+    if (NULL != transposition_move && chess_is_same_move(move, transposition_move))
+        return 1 << 30;
+    if (ply < state->pv_length && chess_is_same_move(move, &state->pv[ply]))
+        return 1 << 29;
+
+    int victim = board[move->destination];
+    if (EMPTY != victim)
+        return (1 << 28) + abs(PIECE_VALUES[victim]) * 16 - abs(PIECE_VALUES[board[move->origin]]) / 16;
+
+    for (int i = 0; i < SEARCH_KILLER_MOVES; i++)
+    {
+        if (chess_is_same_move(move, &state->killers[ply][i]))
+            return (1 << 27) - i;
+    }
+    return state->history[move->origin][move->destination];
+}
+
+int _chess_search_node(chess_SearchState *state, const int board[BOARD_SIZE], const chess_Team team, const int depth, const int ply, int alpha, const int beta)
+{
+    state->pv_table_length[ply] = 0;
+    state->nodes++;
+    if ((state->max_nodes > 0 && state->nodes >= state->max_nodes) || (state->has_deadline && 0 == state->nodes % SEARCH_TIME_CHECK_INTERVAL && clock() >= state->deadline))
+        state->stopped = true;
+    if (state->stopped)
+        return 0;
+
+    int sign = chess_WHITE == team ? 1 : -1;
+    if (ply >= SEARCH_MAX_PLY - 1)
+        return sign * chess_evaluate_material(board);
+
+    uint64_t hash = chess_compute_zobrist_hash(board, team);
+    chess_TranspositionEntry *entry = _chess_probe_transposition_table(state, hash);
+    chess_Move transposition_move = {-1, -1};
+    if (NULL != entry)
+    {
+        transposition_move = (chess_Move){entry->origin, entry->destination};
+        int score = entry->score;
+        if (score > SEARCH_MATE_SCORE - SEARCH_MAX_PLY)
+            score -= ply;
+        else if (score < -SEARCH_MATE_SCORE + SEARCH_MAX_PLY)
+            score += ply;
+
+        if (ply > 0 && entry->depth >= depth &&
+            (chess_BOUND_EXACT == entry->bound || (chess_BOUND_LOWER == entry->bound && score >= beta) || (chess_BOUND_UPPER == entry->bound && score <= alpha)))
+            return score;
+    }
+
+    if (depth <= 0)
+        return sign * chess_evaluate_material(board);
+
+    chess_MovesLinkedList *move_list = &((chess_MovesLinkedList){NULL});
+    chess_compute_legal_moves(board, team, move_list);
+    if (0 == move_list->length)
+        return chess_is_team_in_check(board, team) ? -SEARCH_MATE_SCORE + ply : 0;
+
+    chess_Move moves[SEARCH_MAX_MOVES];
+    int scores[SEARCH_MAX_MOVES];
+    int length = 0;
+    for (chess_MovesLinkedListNode *node = move_list->head; node != NULL && length < SEARCH_MAX_MOVES; node = node->next_node, length++)
+    {
+        moves[length] = *node->move;
+        scores[length] = _chess_score_search_move(state, board, &moves[length], NULL == entry ? NULL : &transposition_move, ply);
+    }
+    chess_free_moves(move_list);
+
+    int original_alpha = alpha;
+    int best_score = -SEARCH_INFINITY;
+    chess_Move best_move = {-1, -1};
+    for (int i = 0; i < length; i++)
+    {
+        // selection sort, since a cutoff usually happens after the first few moves
+        int best_index = i;
+        for (int j = i + 1; j < length; j++)
+        {
+            if (scores[j] > scores[best_index])
+                best_index = j;
+        }
+        chess_Move move = moves[best_index];
+        moves[best_index] = moves[i];
+        scores[best_index] = scores[i];
+        moves[i] = move;
+
+        int new_board[BOARD_SIZE];
+        memcpy(new_board, board, sizeof(new_board));
+        bool is_capture = EMPTY != board[move.destination];
+        chess_update_board_with_move(new_board, &move);
+        int score = -_chess_search_node(state, new_board, chess_get_opposing_team(team), depth - 1, ply + 1, -beta, -alpha);
+        if (state->stopped)
+            return 0;
+
+        if (score > best_score)
+        {
+            best_score = score;
+            best_move = move;
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+            state->pv_table[ply][0] = move;
+            memcpy(&state->pv_table[ply][1], state->pv_table[ply + 1], state->pv_table_length[ply + 1] * sizeof(chess_Move));
+            state->pv_table_length[ply] = state->pv_table_length[ply + 1] + 1;
+        }
+        if (score >= beta)
+        {
+            if (!is_capture)
+            {
+                if (!chess_is_same_move(&move, &state->killers[ply][0]))
+                {
+                    state->killers[ply][1] = state->killers[ply][0];
+                    state->killers[ply][0] = move;
+                }
+                state->history[move.origin][move.destination] += depth * depth;
+            }
+            break;
+        }
+    }
+
+    chess_Bound bound = best_score >= beta ? chess_BOUND_LOWER : best_score > original_alpha ? chess_BOUND_EXACT : chess_BOUND_UPPER;
+    _chess_store_transposition_entry(state, hash, depth, best_score, ply, bound, &best_move);
+    return best_score;
+}
+
+/*
+Searches the position with iterative deepening for at most max_time seconds and max_nodes nodes (each unlimited if 0,
+but not both) and returns the best move of the deepest completed iteration. If the position is the one pondered on last
+(a ponder hit), the search continues at the depth following the one reached while pondering.
+*/
+chess_SearchResult chess_search(chess_SearchState *state, const int board[BOARD_SIZE], const chess_Team team, const double max_time, const long max_nodes)
+{
+    chess_SearchResult result = {{-1, -1}, 0, 0, 0, false};
+    uint64_t hash = chess_compute_zobrist_hash(board, team);
+    int start_depth = 1;
+    if (state->persistent && 0 != state->ponder_hash && hash == state->ponder_hash && state->ponder_depth > 0)
+    {
+        result.ponder_hit = true;
+        result.move = state->pv[0];
+        result.depth = state->ponder_depth;
+        start_depth = state->ponder_depth + 1;
+    }
+    else
+    {
+        // the pondered position is as many plies from the previous root as this one
+        bool has_pondered = 0 != state->ponder_hash;
+        _chess_prepare_search_state(state, hash, has_pondered ? 0 : 2);
+    }
+    state->ponder_hash = 0;
+    state->max_nodes = max_nodes;
+
+    // no deadline rather than a huge one, which may not fit in a 32-bit clock_t
+    state->has_deadline = max_time > 0;
+    if (state->has_deadline)
+        state->deadline = clock() + (clock_t)(max_time * CLOCKS_PER_SEC);
+    state->nodes = 0;
+    state->stopped = false;
+    for (int depth = start_depth; depth < SEARCH_MAX_PLY; depth++)
+    {
+        int score = _chess_search_node(state, board, team, depth, 0, -SEARCH_INFINITY, SEARCH_INFINITY);
+        if (state->stopped || 0 == state->pv_table_length[0])
+            break;
+
+        result.move = state->pv_table[0][0];
+        result.score = score;
+        result.depth = depth;
+        state->pv_length = state->pv_table_length[0];
+        memcpy(state->pv, state->pv_table[0], state->pv_length * sizeof(chess_Move));
+        if (abs(score) > SEARCH_MATE_SCORE - SEARCH_MAX_PLY)
+            break;
+    }
+    result.nodes = state->nodes;
+
+    state->expected_hash = 0;
+    if (state->pv_length > 2)
+    {
+        int expected_board[BOARD_SIZE];
+        memcpy(expected_board, board, sizeof(expected_board));
+        chess_update_board_with_move(expected_board, &state->pv[0]);
+        chess_update_board_with_move(expected_board, &state->pv[1]);
+        state->expected_hash = chess_compute_zobrist_hash(expected_board, team);
+    }
+    return result;
+}
+
+/*
+Searches the position arising from the expected reply of the opponent for at most max_time seconds and max_nodes nodes,
+meant to run during the opponent's time. board is the position after our move with opponent to move.
+The expected reply is the best move stored in the transposition table; without one there is nothing to ponder.
+*/
+chess_SearchResult chess_ponder(chess_SearchState *state, const int board[BOARD_SIZE], const chess_Team opponent, const double max_time, const long max_nodes)
+{
+    chess_SearchResult result = {{-1, -1}, 0, 0, 0, false};
+    chess_TranspositionEntry *entry = _chess_probe_transposition_table(state, chess_compute_zobrist_hash(board, opponent));
+    if (!state->persistent || NULL == entry || entry->origin < 0)
+        return result;
+
+    int ponder_board[BOARD_SIZE];
+    memcpy(ponder_board, board, sizeof(ponder_board));
+    chess_update_board_with_move(ponder_board, &(chess_Move){entry->origin, entry->destination});
+    chess_Team team = chess_get_opposing_team(opponent);
+    result = chess_search(state, ponder_board, team, max_time, max_nodes);
+    state->ponder_hash = chess_compute_zobrist_hash(ponder_board, team);
+    state->ponder_depth = result.depth;
+    return result;
+}
+
+/*
+Replays self-play game lines from each of SELF_PLAY_POSITIONS with search states that are cleared every move,
+persistent, and persistent with pondering, and prints the average depth reached per move with each.
+The lines are played by the first configuration, so all of them search the same positions. Searches are limited
+to move_nodes nodes instead of time, so the results are reproducible.
+*/
+int chess_run_self_play_benchmark(const int plies, const long move_nodes)
+{
+    const char *names[] = {"cleared", "persistent", "persistent + ponder"};
+    chess_Move lines[SELF_PLAY_POSITION_COUNT][SELF_PLAY_PLIES];
+    int line_lengths[SELF_PLAY_POSITION_COUNT] = {0};
+    for (int configuration = 0; configuration < 3; configuration++)
+    {
+        int total_depth = 0;
+        int ponder_hits = 0;
+        int searches = 0;
+        for (int position = 0; position < SELF_PLAY_POSITION_COUNT; position++)
+        {
+            chess_SearchState *states[BITBOARD_TEAMS] = {chess_create_search_state(configuration > 0), chess_create_search_state(configuration > 0)};
+            chess_Move *line = lines[position];
+            int board[BOARD_SIZE];
+            chess_init_board(board, SELF_PLAY_POSITIONS[position]);
+            chess_Team team = chess_WHITE;
+            for (int ply = 0; ply < plies && ply < SELF_PLAY_PLIES; ply++)
+            {
+                if (configuration > 0 && ply >= line_lengths[position])
+                    break;
+
+                chess_SearchResult result = chess_search(states[team], board, team, SEARCH_UNLIMITED_TIME, move_nodes);
+                if (0 == configuration)
+                {
+                    if (result.move.origin < 0)
+                        break;
+                    line[line_lengths[position]++] = result.move;
+                }
+                total_depth += result.depth;
+                ponder_hits += result.ponder_hit;
+                searches++;
+
+                chess_update_board_with_move(board, &line[ply]);
+                if (2 == configuration)
+                    chess_ponder(states[team], board, chess_get_opposing_team(team), SEARCH_UNLIMITED_TIME, move_nodes);
+                team = chess_get_opposing_team(team);
+            }
+            chess_free_search_state(states[chess_WHITE]);
+            chess_free_search_state(states[chess_BLACK]);
+        }
+
+        printf("%s: average depth %.2f over %i moves, %i ponder hits\n", names[configuration], searches > 0 ? (double)total_depth / searches : 0.0, searches, ponder_hits);
+    }
+    return 0;
+}
+
+/*
+Plays a node-limited self-play game from each of SELF_PLAY_POSITIONS, appending every position with its search score
+and the game result (1, 0 or -1 from the point of view of white; 0 also for unfinished games) to the packed record
+file at path, one block per game. Reads the file back through the memory-mapped reader and prints the bytes used
+per record. Returns 1 if the file cannot be written or read, or if any decoded record differs from the one appended.
+*/
+int chess_run_packed_record_check(const char path[], const int plies, const long move_nodes)
+{
+    static int boards[SELF_PLAY_POSITION_COUNT * SELF_PLAY_PLIES][BOARD_SIZE];
+    static chess_Team teams[SELF_PLAY_POSITION_COUNT * SELF_PLAY_PLIES];
+    static int halfmove_clocks[SELF_PLAY_POSITION_COUNT * SELF_PLAY_PLIES];
+    static int fullmove_numbers[SELF_PLAY_POSITION_COUNT * SELF_PLAY_PLIES];
+    static chess_PackedRecord records[SELF_PLAY_POSITION_COUNT * SELF_PLAY_PLIES];
+    int length = 0;
+
+    remove(path);
+    for (int position = 0; position < SELF_PLAY_POSITION_COUNT; position++)
+    {
+        chess_SearchState *states[BITBOARD_TEAMS] = {chess_create_search_state(true), chess_create_search_state(true)};
+        int board[BOARD_SIZE];
+        chess_init_board(board, SELF_PLAY_POSITIONS[position]);
+        chess_Team team = chess_WHITE;
+        int halfmove_clock = 0;
+        int fullmove_number = 1;
+        int game_start = length;
+        int game_result = 0;
+        for (int ply = 0; ply < plies && ply < SELF_PLAY_PLIES; ply++)
+        {
+            chess_SearchResult result = chess_search(states[team], board, team, SEARCH_UNLIMITED_TIME, move_nodes);
+            if (result.move.origin < 0)
+            {
+                if (chess_is_team_in_check(board, team))
+                    game_result = chess_WHITE == team ? -1 : 1;
+                break;
+            }
+
+            memcpy(boards[length], board, sizeof(board));
+            teams[length] = team;
+            halfmove_clocks[length] = halfmove_clock;
+            fullmove_numbers[length] = fullmove_number;
+            records[length].score = result.score > INT16_MAX ? INT16_MAX : (result.score < -INT16_MAX ? -INT16_MAX : result.score);
+            records[length].reserved = 0;
+            if (chess_encode_packed_position(board, team, halfmove_clock, fullmove_number, &records[length].position))
+                break;
+            length++;
+
+            bool resets_clock = chess_is_pawn(board[result.move.origin]) || EMPTY != board[result.move.destination];
+            halfmove_clock = resets_clock ? 0 : halfmove_clock + 1;
+            if (chess_BLACK == team)
+                fullmove_number++;
+            chess_update_board_with_move(board, &result.move);
+            team = chess_get_opposing_team(team);
+        }
+        chess_free_search_state(states[chess_WHITE]);
+        chess_free_search_state(states[chess_BLACK]);
+
+        // the result is only known once the game is over, so the records are appended afterwards
+        chess_PackedRecordWriter *writer = chess_open_packed_record_writer(path);
+        if (NULL == writer)
+            return 1;
+        chess_error_code error_code = 0;
+        for (int i = game_start; i < length; i++)
+        {
+            records[i].result = game_result;
+            error_code += chess_append_packed_record(writer, &records[i]);
+        }
+        error_code += chess_close_packed_record_writer(writer);
+        if (error_code)
+            return 1;
+    }
+
+    chess_PackedRecordReader *reader = chess_open_packed_record_reader(path);
+    if (NULL == reader)
+        return 1;
+
+    size_t file_size = reader->size;
+    int read_length = 0;
+    int mismatches = 0;
+    chess_PackedRecord record;
+    while (chess_read_packed_record(reader, &record))
+    {
+        int board[BOARD_SIZE];
+        chess_Team team;
+        int halfmove_clock;
+        int fullmove_number;
+        if (read_length >= length ||
+            chess_decode_packed_position(&record.position, board, &team, &halfmove_clock, &fullmove_number) ||
+            0 != memcmp(board, boards[read_length], sizeof(board)) || team != teams[read_length] ||
+            halfmove_clock != halfmove_clocks[read_length] || fullmove_number != fullmove_numbers[read_length] ||
+            record.score != records[read_length].score || record.result != records[read_length].result)
+            mismatches++;
+        read_length++;
+    }
+    chess_close_packed_record_reader(reader);
+
+    printf("Read back %i of %i records, %i differing: %zu bytes, %.2f bytes per record (%i uncompressed, %i as an int board)\n",
+           read_length, length, mismatches, file_size, length > 0 ? (double)file_size / length : 0.0, PACKED_RECORD_SIZE, (int)(BOARD_SIZE * sizeof(int)));
+    return mismatches > 0 || read_length != length;
+}
+
+void chess_convert_to_compact_board(const int board[BOARD_SIZE], chess_CompactBoard *compact_board)
+{
+    for (int i = 0; i < BOARD_SIZE; i++)
+        compact_board->squares[i] = board[i];
+}
+
+void chess_convert_from_compact_board(const chess_CompactBoard *compact_board, int board[BOARD_SIZE])
+{
+    for (int i = 0; i < BOARD_SIZE; i++)
+        board[i] = compact_board->squares[i];
+}
+
+bool chess_is_team_piece(const int piece, const chess_Team team)
+{
+    return chess_WHITE == team ? chess_is_white(piece) : chess_is_black(piece);
+}
+
+// Returns whether the KING_MOVE_INDEX_OFFSETS direction is diagonal rather than straight.
+bool chess_is_diagonal_direction(const int direction)
+{
+    return KING_MOVE_INDEX_OFFSETS[direction].x != 0 && KING_MOVE_INDEX_OFFSETS[direction].y != 0;
+}
+
+bool chess_is_compact_square_attacked(const chess_CompactBoard *board, const int board_index, const chess_Team attacker)
+{
+    const int8_t *squares = board->squares;
+    for (int i = 0; KNIGHT_TARGETS[board_index][i] != LEAPER_TARGETS_END; i++)
+    {
+        int piece = squares[KNIGHT_TARGETS[board_index][i]];
+        if (chess_is_team_piece(piece, attacker) && chess_KNIGHT == chess_get_piece_type(piece))
+            return true;
+    }
+    for (int i = 0; KING_TARGETS[board_index][i] != LEAPER_TARGETS_END; i++)
+    {
+        int piece = squares[KING_TARGETS[board_index][i]];
+        if (chess_is_team_piece(piece, attacker) && chess_KING == chess_get_piece_type(piece))
+            return true;
+    }
+
+    // pawns attack diagonally forwards, so they are found diagonally backwards from the attacked square
+    int x = board_index % BOARD_ROW_SIZE;
+    int pawn_row_offset = chess_WHITE == attacker ? BOARD_ROW_SIZE : -BOARD_ROW_SIZE;
+    for (int dx = -1; dx <= 1; dx += 2)
+    {
+        int pawn_index = board_index + pawn_row_offset + dx;
+        if (chess_check_board_coordinates_out_of_range(x + dx, 0) || chess_check_board_index_out_of_range(pawn_index))
+            continue;
+
+        int piece = squares[pawn_index];
+        if (chess_is_team_piece(piece, attacker) && chess_PAWN == chess_get_piece_type(piece))
+            return true;
+    }
+
+    for (int direction = 0; direction < INDEX_OFFSETS; direction++)
+    {
+        int current_board_index = board_index;
+        for (int i = 0; i < RAY_LENGTHS[board_index][direction]; i++)
+        {
+            current_board_index += RAY_INDEX_STEPS[direction];
+            int piece = squares[current_board_index];
+            if (EMPTY == piece)
+                continue;
+
+            int type = chess_get_piece_type(piece);
+            int slider = chess_is_diagonal_direction(direction) ? chess_BISHOP : chess_ROOK;
+            if (chess_is_team_piece(piece, attacker) && (chess_QUEEN == type || slider == type))
+                return true;
+            break;
+        }
+    }
+    return false;
+}
+
+bool chess_is_compact_team_in_check(const chess_CompactBoard *board, const chess_Team team)
+{
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        int piece = board->squares[i];
+        if (chess_is_team_piece(piece, team) && chess_KING == chess_get_piece_type(piece))
+            return chess_is_compact_square_attacked(board, i, chess_get_opposing_team(team));
+    }
+    return false;
+}
+
+int _chess_append_compact_move(chess_Move moves[SEARCH_MAX_MOVES], int length, const int origin, const int destination)
+{
+    if (length < SEARCH_MAX_MOVES)
+        moves[length++] = (chess_Move){origin, destination};
+    return length;
+}
+
+/*
+Appends the castling moves of the castling king on board_index, under the same conditions as
+chess_compute_white_king_castle_moves and chess_compute_black_king_castle_moves: the rook of that side
+still has its castling right and the squares between king and rook are empty.
+*/
+int _chess_append_compact_castle_moves(const int8_t squares[BOARD_SIZE], const int board_index, const chess_Team team, chess_Move moves[SEARCH_MAX_MOVES], int length)
+{
+    int row_start = board_index - board_index % BOARD_ROW_SIZE;
+    int rook = chess_WHITE == team ? WHITE_ROOK_CASTLE : BLACK_ROOK_CASTLE;
+
+    // queen side
+    bool is_free = rook == squares[row_start];
+    for (int i = row_start + 1; is_free && i < board_index; i++)
+        is_free = EMPTY == squares[i];
+    if (is_free)
+        length = _chess_append_compact_move(moves, length, board_index, board_index - CASTLING_OFFSET);
+
+    // king side
+    const int king_side_rook_index = row_start + BOARD_ROW_SIZE - 1;
+    is_free = rook == squares[king_side_rook_index];
+    for (int i = board_index + 1; is_free && i < king_side_rook_index; i++)
+        is_free = EMPTY == squares[i];
+    if (is_free)
+        length = _chess_append_compact_move(moves, length, board_index, board_index + CASTLING_OFFSET);
+    return length;
+}
+
+/*
+Fills moves with the pseudo-legal moves of team and returns their number.
+Uses the precomputed leaper targets and ray lengths instead of coordinate arithmetic;
+en passant captures are not generated.
+*/
+int chess_generate_compact_moves(const chess_CompactBoard *board, const chess_Team team, chess_Move moves[SEARCH_MAX_MOVES])
+{
+    const int8_t *squares = board->squares;
+    int length = 0;
+    for (int board_index = 0; board_index < BOARD_SIZE; board_index++)
+    {
+        int piece = squares[board_index];
+        if (!chess_is_team_piece(piece, team))
+            continue;
+
+        int type = chess_get_piece_type(piece);
+        if (chess_PAWN == type)
+        {
+            int direction = chess_WHITE == team ? WHITE_PAWN_DIRECTION * BOARD_ROW_SIZE : BLACK_PAWN_DIRECTION * BOARD_ROW_SIZE;
+            bool is_starting_row = chess_WHITE == team ? board_index >= BOARD_WHITE_MIN_PAWN_STARTING_INDEX : board_index < BOARD_BLACK_MAX_PAWN_STARTING_INDEX;
+            int new_board_index = board_index + direction;
+            if (chess_check_board_index_out_of_range(new_board_index))
+                continue;
+
+            if (EMPTY == squares[new_board_index])
+            {
+                length = _chess_append_compact_move(moves, length, board_index, new_board_index);
+                if (is_starting_row && EMPTY == squares[new_board_index + direction])
+                    length = _chess_append_compact_move(moves, length, board_index, new_board_index + direction);
+            }
+
+            int x = board_index % BOARD_ROW_SIZE;
+            for (int dx = -1; dx <= 1; dx += 2)
+            {
+                if (!chess_check_board_coordinates_out_of_range(x + dx, 0) && chess_is_team_piece(squares[new_board_index + dx], chess_get_opposing_team(team)))
+                    length = _chess_append_compact_move(moves, length, board_index, new_board_index + dx);
+            }
+            continue;
+        }
+
+        if (chess_KNIGHT == type || chess_KING == type)
+        {
+            const int8_t *targets = chess_KNIGHT == type ? KNIGHT_TARGETS[board_index] : KING_TARGETS[board_index];
+            for (int i = 0; targets[i] != LEAPER_TARGETS_END; i++)
+            {
+                if (!chess_is_team_piece(squares[targets[i]], team))
+                    length = _chess_append_compact_move(moves, length, board_index, targets[i]);
+            }
+            if (WHITE_KING_CASTLE == piece || BLACK_KING_CASTLE == piece)
+                length = _chess_append_compact_castle_moves(squares, board_index, team, moves, length);
+            continue;
+        }
+
+        for (int direction = 0; direction < INDEX_OFFSETS; direction++)
+        {
+            bool is_diagonal = chess_is_diagonal_direction(direction);
+            if ((chess_BISHOP == type && !is_diagonal) || (chess_ROOK == type && is_diagonal))
+                continue;
+
+            int new_board_index = board_index;
+            for (int i = 0; i < RAY_LENGTHS[board_index][direction]; i++)
+            {
+                new_board_index += RAY_INDEX_STEPS[direction];
+                int target = squares[new_board_index];
+                if (chess_is_team_piece(target, team))
+                    break;
+
+                length = _chess_append_compact_move(moves, length, board_index, new_board_index);
+                if (EMPTY != target)
+                    break;
+            }
+        }
+    }
+    return length;
+}
+
+/*
+Makes the move in place like chess_update_board_with_move, including castling and the loss of castling rights,
+and returns what chess_unmake_compact_move needs to restore the board.
+*/
+chess_CompactUndo chess_make_compact_move(chess_CompactBoard *board, const chess_Move *move)
+{
+    int8_t *squares = board->squares;
+    chess_CompactUndo undo = {.captured = squares[move->destination], .moved = squares[move->origin]};
+    if ((WHITE_KING_CASTLE == undo.moved || BLACK_KING_CASTLE == undo.moved) && abs(move->destination - move->origin) == CASTLING_OFFSET)
+    {
+        int row_start = move->origin - move->origin % BOARD_ROW_SIZE;
+        int rook_index = move->destination > move->origin ? row_start + BOARD_ROW_SIZE - 1 : row_start;
+        squares[(move->origin + move->destination) / 2] = chess_remove_castling_right(squares[rook_index]);
+        squares[rook_index] = EMPTY;
+    }
+    squares[move->destination] = chess_remove_castling_right(undo.moved);
+    squares[move->origin] = EMPTY;
+    return undo;
+}
+
+void chess_unmake_compact_move(chess_CompactBoard *board, const chess_Move *move, const chess_CompactUndo undo)
+{
+    int8_t *squares = board->squares;
+    if ((WHITE_KING_CASTLE == undo.moved || BLACK_KING_CASTLE == undo.moved) && abs(move->destination - move->origin) == CASTLING_OFFSET)
+    {
+        // only rooks that still had their castling right can have castled
+        int row_start = move->origin - move->origin % BOARD_ROW_SIZE;
+        int rook_index = move->destination > move->origin ? row_start + BOARD_ROW_SIZE - 1 : row_start;
+        squares[rook_index] = WHITE_KING_CASTLE == undo.moved ? WHITE_ROOK_CASTLE : BLACK_ROOK_CASTLE;
+        squares[(move->origin + move->destination) / 2] = EMPTY;
+    }
+    squares[move->origin] = undo.moved;
+    squares[move->destination] = undo.captured;
+}
+
+// Counts the leaf nodes of the legal move tree, copying the 64-byte board for every move (copy-make).
+long chess_perft_compact_copy_make(const chess_CompactBoard *board, const chess_Team team, const int depth)
+{
+    if (0 == depth)
+        return 1;
+
+    chess_Move moves[SEARCH_MAX_MOVES];
+    int length = chess_generate_compact_moves(board, team, moves);
+    long nodes = 0;
+    for (int i = 0; i < length; i++)
+    {
+        chess_CompactBoard new_board = *board;
+        chess_make_compact_move(&new_board, &moves[i]);
+        if (!chess_is_compact_team_in_check(&new_board, team))
+            nodes += chess_perft_compact_copy_make(&new_board, chess_get_opposing_team(team), depth - 1);
+    }
+    return nodes;
+}
+
+// Counts the leaf nodes of the legal move tree, making and unmaking every move on a single board.
+long chess_perft_compact_make_unmake(chess_CompactBoard *board, const chess_Team team, const int depth)
+{
+    if (0 == depth)
+        return 1;
+
+    chess_Move moves[SEARCH_MAX_MOVES];
+    int length = chess_generate_compact_moves(board, team, moves);
+    long nodes = 0;
+    for (int i = 0; i < length; i++)
+    {
+        chess_CompactUndo undo = chess_make_compact_move(board, &moves[i]);
+        if (!chess_is_compact_team_in_check(board, team))
+            nodes += chess_perft_compact_make_unmake(board, chess_get_opposing_team(team), depth - 1);
+        chess_unmake_compact_move(board, &moves[i], undo);
+    }
+    return nodes;
+}
+
+// Returns the material balance from the point of view of white.
+int chess_evaluate_compact_material(const chess_CompactBoard *board)
+{
+    int score = 0;
+    for (int i = 0; i < BOARD_SIZE; i++)
+        score += PIECE_VALUES[board->squares[i]];
+    return score;
+}
+
+/*
+Alpha-beta search on the compact board, applying moves with copy-make or make/unmake depending on mode.
+Both modes visit the same nodes in the same order, so they return the same score; the board is unchanged on return.
+*/
+int _chess_search_compact_node(chess_CompactBoard *board, const chess_Team team, const int depth, const int ply, int alpha, const int beta, const chess_CompactMoveMode mode, long *nodes, chess_Move *best_move)
+{
+    (*nodes)++;
+    int sign = chess_WHITE == team ? 1 : -1;
+    if (depth <= 0)
+        return sign * chess_evaluate_compact_material(board);
+
+    chess_Move moves[SEARCH_MAX_MOVES];
+    int scores[SEARCH_MAX_MOVES];
+    int length = chess_generate_compact_moves(board, team, moves);
+    for (int i = 0; i < length; i++)
+    {
+        int victim = board->squares[moves[i].destination];
+        scores[i] = EMPTY == victim ? 0 : abs(PIECE_VALUES[victim]) * 16 - abs(PIECE_VALUES[board->squares[moves[i].origin]]) / 16;
+    }
+
+    int best_score = -SEARCH_INFINITY;
+    bool has_legal_move = false;
+    for (int i = 0; i < length; i++)
+    {
+        // selection sort, captures of the most valuable pieces first
+        int best_index = i;
+        for (int j = i + 1; j < length; j++)
+        {
+            if (scores[j] > scores[best_index])
+                best_index = j;
+        }
+        chess_Move move = moves[best_index];
+        moves[best_index] = moves[i];
+        scores[best_index] = scores[i];
+
+        int score;
+        if (chess_COPY_MAKE == mode)
+        {
+            chess_CompactBoard new_board = *board;
+            chess_make_compact_move(&new_board, &move);
+            if (chess_is_compact_team_in_check(&new_board, team))
+                continue;
+            score = -_chess_search_compact_node(&new_board, chess_get_opposing_team(team), depth - 1, ply + 1, -beta, -alpha, mode, nodes, NULL);
+        }
+        else
+        {
+            chess_CompactUndo undo = chess_make_compact_move(board, &move);
+            bool is_illegal = chess_is_compact_team_in_check(board, team);
+            if (!is_illegal)
+                score = -_chess_search_compact_node(board, chess_get_opposing_team(team), depth - 1, ply + 1, -beta, -alpha, mode, nodes, NULL);
+            chess_unmake_compact_move(board, &move, undo);
+            if (is_illegal)
+                continue;
+        }
+
+        has_legal_move = true;
+        if (score > best_score)
+        {
+            best_score = score;
+            if (NULL != best_move)
+                *best_move = move;
+        }
+        if (score > alpha)
+            alpha = score;
+        if (alpha >= beta)
+            break;
+    }
+
+    if (!has_legal_move)
+        return chess_is_compact_team_in_check(board, team) ? -SEARCH_MATE_SCORE + ply : 0;
+    return best_score;
+}
+
+// Searches the compact board to a fixed depth without transposition table or move ordering heuristics.
+chess_SearchResult chess_search_compact(const chess_CompactBoard *board, const chess_Team team, const int depth, const chess_CompactMoveMode mode)
+{
+    chess_CompactBoard search_board = *board;
+    chess_SearchResult result = {.move = {-1, -1}, .depth = depth};
+    result.score = _chess_search_compact_node(&search_board, team, depth, 0, -SEARCH_INFINITY, SEARCH_INFINITY, mode, &result.nodes, &result.move);
+    return result;
+}
+
+// Counts the leaf nodes of the legal move tree on the int board, using the linked-list move generator.
+long chess_perft(const int board[BOARD_SIZE], const chess_Team team, const int depth)
+{
+    if (0 == depth)
+        return 1;
+
+    chess_MovesLinkedList *moves = &((chess_MovesLinkedList){NULL});
+    chess_compute_legal_moves(board, team, moves);
+    long nodes = 0;
+    for (chess_MovesLinkedListNode *node = moves->head; node != NULL; node = node->next_node)
+    {
+        int new_board[BOARD_SIZE];
+        memcpy(new_board, board, sizeof(new_board));
+        chess_update_board_with_move(new_board, node->move);
+        nodes += chess_perft(new_board, chess_get_opposing_team(team), depth - 1);
+    }
+    chess_free_moves(moves);
+    return nodes;
+}
+
+/*
+Fills a batch of length positions from random games (restarted from the initial position once over) and computes
+their move counts with the linked-list move generator, the scalar batch and the AVX2 batch, timing each.
+Castling rights are removed from the positions, since the batch does not represent them. A length that is not a
+multiple of BITBOARD_AVX2_LANES also exercises the scalar remainder of the AVX2 path.
+Returns 1 if any batch move count differs from the number of moves of the linked-list generator.
+*/
+int chess_run_board_batch_benchmark(const int length)
+{
+    int (*boards)[BOARD_SIZE] = malloc(length * sizeof(*boards));
+    uint32_t *expected_counts[BITBOARD_TEAMS] = {malloc(length * sizeof(uint32_t)), malloc(length * sizeof(uint32_t))};
+    chess_BoardBatch *batch = chess_create_board_batch(length);
+
+    srand(BOARD_BATCH_BENCHMARK_SEED);
+    int board[BOARD_SIZE];
+    chess_init_board(board, "");
+    chess_Team team = chess_WHITE;
+    int ply = 0;
+    for (int i = 0; i < length; i++)
+    {
+        for (int j = 0; j < BOARD_SIZE; j++)
+            boards[i][j] = chess_remove_castling_right(board[j]);
+        chess_set_board_batch_position(batch, i, boards[i]);
+
+        chess_MovesLinkedList *moves = &((chess_MovesLinkedList){NULL});
+        chess_compute_legal_moves(board, team, moves);
+        if (0 == moves->length || ++ply >= BOARD_BATCH_MAX_GAME_PLIES)
+        {
+            chess_init_board(board, "");
+            team = chess_WHITE;
+            ply = 0;
+        }
+        else
+        {
+            chess_update_board_with_move(board, chess_get_move(moves, rand() % moves->length));
+            team = chess_get_opposing_team(team);
+        }
+        chess_free_moves(moves);
+    }
+
+    clock_t start_time = clock();
+    for (int i = 0; i < length; i++)
+    {
+        for (int j = 0; j < BITBOARD_TEAMS; j++)
+        {
+            chess_MovesLinkedList *moves = &((chess_MovesLinkedList){NULL});
+            chess_compute_team_moves(boards[i], j, moves);
+            expected_counts[j][i] = moves->length;
+            chess_free_moves(moves);
+        }
+    }
+    double elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
+    printf("linked list: %i positions in %.4f s (%.0f positions/s)\n", length, elapsed_time, elapsed_time > 0 ? length / elapsed_time : 0.0);
+
+    const char *names[] = {"scalar batch", "AVX2 batch"};
+    int mismatches = 0;
+    for (int use_avx2 = 0; use_avx2 <= 1; use_avx2++)
+    {
+        if (use_avx2 && !chess_has_avx2())
+        {
+            printf("%s: not supported by this CPU\n", names[use_avx2]);
+            continue;
+        }
+
+        for (int j = 0; j < BITBOARD_TEAMS; j++)
+            memset(batch->move_counts[j], 0, length * sizeof(uint32_t));
+        start_time = clock();
+        for (int round = 0; round < BOARD_BATCH_BENCHMARK_ROUNDS; round++)
+            chess_compute_board_batch_moves(batch, use_avx2);
+        elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC / BOARD_BATCH_BENCHMARK_ROUNDS;
+
+        int differing = 0;
+        for (int i = 0; i < length; i++)
+        {
+            for (int j = 0; j < BITBOARD_TEAMS; j++)
+                differing += batch->move_counts[j][i] != expected_counts[j][i];
+        }
+        printf("%s: %i positions in %.4f s (%.0f positions/s), %i differing move counts\n", names[use_avx2], length, elapsed_time, elapsed_time > 0 ? length / elapsed_time : 0.0, differing);
+        mismatches += differing;
+    }
+
+    chess_free_board_batch(batch);
+    free(expected_counts[chess_WHITE]);
+    free(expected_counts[chess_BLACK]);
+    free(boards);
+    return mismatches > 0;
+}
+
+/*
+Times perft from the starting position and from PERFT_CASTLING_FEN with the int board and with the compact board,
+both copy-make and make/unmake, then times the compact-board search with both move modes, so the faster option
+can be chosen. Returns 1 if the perft node counts or the search results differ.
+*/
+int chess_run_perft_benchmark(const int depth)
+{
+    const char *fens[] = {"", PERFT_CASTLING_FEN};
+    const char *names[] = {"int board, copy-make", "compact board, copy-make", "compact board, make/unmake"};
+    int error_code = 0;
+    for (int position = 0; position < 2; position++)
+    {
+        int board[BOARD_SIZE];
+        chess_init_board(board, fens[position]);
+        chess_CompactBoard compact_board;
+        chess_convert_to_compact_board(board, &compact_board);
+
+        long nodes[3];
+        for (int i = 0; i < 3; i++)
+        {
+            clock_t start_time = clock();
+            if (0 == i)
+                nodes[i] = chess_perft(board, chess_WHITE, depth);
+            else if (1 == i)
+                nodes[i] = chess_perft_compact_copy_make(&compact_board, chess_WHITE, depth);
+            else
+                nodes[i] = chess_perft_compact_make_unmake(&compact_board, chess_WHITE, depth);
+            double elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
+            printf("%s: perft(%i) = %li in %.3f s (%.0f nodes/s)\n", names[i], depth, nodes[i], elapsed_time, elapsed_time > 0 ? nodes[i] / elapsed_time : 0.0);
+        }
+        error_code |= nodes[0] != nodes[1] || nodes[1] != nodes[2];
+    }
+
+    int board[BOARD_SIZE];
+    chess_init_board(board, "");
+    chess_CompactBoard compact_board;
+    chess_convert_to_compact_board(board, &compact_board);
+    const char *mode_names[] = {"compact search, copy-make", "compact search, make/unmake"};
+    chess_SearchResult results[2];
+    for (int mode = chess_COPY_MAKE; mode <= chess_MAKE_UNMAKE; mode++)
+    {
+        clock_t start_time = clock();
+        results[mode] = chess_search_compact(&compact_board, chess_WHITE, COMPACT_SEARCH_BENCHMARK_DEPTH, mode);
+        double elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
+        printf("%s: depth %i, score %i, %li nodes in %.3f s (%.0f nodes/s)\n", mode_names[mode], results[mode].depth, results[mode].score, results[mode].nodes, elapsed_time, elapsed_time > 0 ? results[mode].nodes / elapsed_time : 0.0);
+    }
+    error_code |= results[0].score != results[1].score || results[0].nodes != results[1].nodes || !chess_is_same_move(&results[0].move, &results[1].move);
+    return error_code;
+}
+
+//
+void log_moves(chess_MovesLinkedList *moves)
+{
+    if (NULL == moves)
+        return;
+
+    chess_MovesLinkedListNode *node = moves->head;
+    while (node != NULL)
+    {
+        chess_Move *move = node->move;
+        printf("Move from %i to %i\n", move->origin, move->destination);
+        node = node->next_node;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && 0 == strcmp(argv[1], "mate"))
+        return chess_run_mate_puzzle_suite(MATE_SEARCH_MEMORY_LIMIT) != 0;
+    if (argc > 1 && 0 == strcmp(argv[1], "selfplay"))
+        return chess_run_self_play_benchmark(SELF_PLAY_PLIES, SELF_PLAY_MOVE_NODES);
+    if (argc > 1 && 0 == strcmp(argv[1], "records"))
+        return chess_run_packed_record_check(argc > 2 ? argv[2] : PACKED_RECORD_CHECK_PATH, SELF_PLAY_PLIES, SELF_PLAY_MOVE_NODES);
+    if (argc > 1 && 0 == strcmp(argv[1], "batch"))
+        return chess_run_board_batch_benchmark(BOARD_BATCH_BENCHMARK_LENGTH);
+    if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+        return chess_run_perft_benchmark(PERFT_BENCHMARK_DEPTH);
+
     int board[BOARD_SIZE] = {0};
     chess_init_board(board, "");
     chess_print_board(board);
@@ -30,11 +30,62 @@
 
 #define INDEX_OFFSETS 8
 #define DIAGONAL_MOVES 4
+#define LEAPER_TARGETS 9
+#define LEAPER_TARGETS_END -1
 
 #define BITS_PER_PIECE 5
 
 #define FEN_MAX_STRING_LENGTH 90
 
+#define PACKED_MAX_PIECES 32
+#define PACKED_PIECE_CODES 16
+#define PACKED_FLAG_BLACK_TO_MOVE 1
+#define PACKED_FLAG_WHITE_KING_CASTLE 2
+#define PACKED_FLAG_BLACK_KING_CASTLE 4
+#define PACKED_RECORD_SIZE 32
+#define PACKED_BLOCK_RECORDS 4096
+#define PACKED_BLOCK_MAGIC 0x42434854
+#define PACKED_BLOCK_HEADER_SIZE 16
+#define PACKED_RECORD_MASK_SIZE 4
+#define PACKED_RECORD_CHECK_PATH "selfplay.thcc"
+
+#define BITBOARD_TEAMS 2
+#define BITBOARD_PIECE_TYPES 6
+#define BITBOARD_LINE_DIRECTIONS 4
+#define BITBOARD_AVX2_LANES 4
+#define BOARD_BATCH_BENCHMARK_LENGTH 100003
+#define BOARD_BATCH_BENCHMARK_ROUNDS 10
+#define BOARD_BATCH_BENCHMARK_SEED 1
+#define BOARD_BATCH_MAX_GAME_PLIES 200
+#define BITBOARD_FILE_A 0x0101010101010101ULL
+#define BITBOARD_FILE_B 0x0202020202020202ULL
+#define BITBOARD_FILE_G 0x4040404040404040ULL
+#define BITBOARD_FILE_H 0x8080808080808080ULL
+#define BITBOARD_WHITE_DOUBLE_PUSH_RANK 0x0000FF0000000000ULL
+#define BITBOARD_BLACK_DOUBLE_PUSH_RANK 0x0000000000FF0000ULL
+
+#define PROOF_NUMBER_INFINITY UINT32_MAX
+#define PROOF_NODE_NONE -1
+#define MATE_SEARCH_MEMORY_LIMIT (64 * 1024 * 1024)
+#define MATE_PUZZLE_COUNT 12
+#define MATE_PUZZLE_SMALL_POOL_NODES 25000
+#define MATE_PUZZLE_TINY_POOL_NODES 2000
+
+#define SEARCH_MAX_PLY 64
+#define SEARCH_MAX_MOVES 256
+#define SEARCH_KILLER_MOVES 2
+#define SEARCH_INFINITY 1000000
+#define SEARCH_MATE_SCORE 100000
+#define SEARCH_TIME_CHECK_INTERVAL 1024
+#define TRANSPOSITION_TABLE_ENTRIES (1 << 18)
+#define SEARCH_UNLIMITED_TIME 0
+#define SELF_PLAY_PLIES 30
+#define SELF_PLAY_MOVE_NODES 5000
+#define SELF_PLAY_POSITION_COUNT 4
+#define PERFT_BENCHMARK_DEPTH 5
+#define PERFT_CASTLING_FEN "r3k2r/p1pp1pp1/8/8/8/8/P1PP1PP1/R3K2R w KQkq - 0 1"
+#define COMPACT_SEARCH_BENCHMARK_DEPTH 7
+
 #define DEBUG 3
 #define INFO 2
 #define WARNING 1
@@ -52,18 +103,63 @@ typedef enum
     chess_BLACK
 } chess_Team;
 
+typedef enum
+{
+    chess_PAWN,
+    chess_KNIGHT,
+    chess_BISHOP,
+    chess_ROOK,
+    chess_QUEEN,
+    chess_KING
+} chess_PieceType;
+
 typedef struct
 {
     int x;
     int y;
 } chess_Coordinates;
 
+/*
+A bitboard move by shift squares (left shift if positive, right shift if negative),
+with mask clearing the destination squares that would have wrapped around the board edge.
+*/
+typedef struct
+{
+    int shift;
+    uint64_t mask;
+} chess_BitboardDirection;
+
 typedef struct
 {
     int origin;
     int destination;
 } chess_Move;
 
+/*
+Board of 64 int8_t squares, fitting exactly one cache line. Piece values are the same as for the int board,
+which already encode castling rights and en passant, so the side to move is the only state kept outside of it.
+*/
+typedef struct
+{
+    _Alignas(64) int8_t squares[BOARD_SIZE];
+} chess_CompactBoard;
+
+_Static_assert(sizeof(chess_CompactBoard) == 64, "chess_CompactBoard must fit one cache line");
+
+// What chess_unmake_compact_move needs to restore the board: the captured piece and the moved piece before the move.
+typedef struct
+{
+    int8_t captured;
+    int8_t moved;
+} chess_CompactUndo;
+
+// How the compact-board search applies moves: on a copy of the board, or in place and reverted afterwards.
+typedef enum
+{
+    chess_COPY_MAKE,
+    chess_MAKE_UNMAKE
+} chess_CompactMoveMode;
+
 typedef struct chess_MovesLinkedListNode_
 {
     chess_Move *move;
@@ -77,9 +173,425 @@ typedef struct
     int length;
 } chess_MovesLinkedList;
 
-const chess_Coordinates KNIGHT_MOVE_INDEX_OFFSETS[INDEX_OFFSETS] = {{-2, -1}, {-2, 1}, {2, -1}, {2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}};
+/*
+Compact position encoding: a little-endian occupancy bitmask (bit i set if board square i is occupied)
+followed by one 4-bit piece code per occupied square, in ascending square order.
+Castling rights of the rooks and en passant capable pawns have their own piece codes,
+castling rights of the kings and the side to move are stored in flags.
+*/
+typedef struct
+{
+    uint8_t occupancy[8];
+    uint8_t pieces[PACKED_MAX_PIECES / 2];
+    uint8_t flags;
+    uint8_t halfmove_clock;
+    uint16_t fullmove_number;
+} chess_PackedPosition;
+
+typedef struct
+{
+    chess_PackedPosition position;
+    int16_t score;
+    int8_t result;
+    uint8_t reserved;
+} chess_PackedRecord;
+
+_Static_assert(sizeof(chess_PackedRecord) == PACKED_RECORD_SIZE, "chess_PackedRecord must stay 32 bytes");
+
+/*
+Buffers appended records and writes them out as compressed blocks of up to PACKED_BLOCK_RECORDS records.
+A block is a little-endian header of magic, record count, payload size and payload checksum, followed by the payload.
+*/
+typedef struct
+{
+    int file_descriptor;
+    int length;
+    chess_PackedRecord records[PACKED_BLOCK_RECORDS];
+} chess_PackedRecordWriter;
+
+// Memory-maps a packed record file and decodes it one block at a time.
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+    int length;
+    int index;
+    chess_PackedRecord records[PACKED_BLOCK_RECORDS];
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#endif
+} chess_PackedRecordReader;
+
+/*
+Structure-of-arrays batch of independent positions: bitboards[team][piece_type][i] holds the squares
+of that piece type for position i, with bit n corresponding to board index n.
+Castling rights and en passant are not represented; move counts are pseudo-legal and exclude them.
+*/
+typedef struct
+{
+    int length;
+    uint64_t *bitboards[BITBOARD_TEAMS][BITBOARD_PIECE_TYPES];
+    uint64_t *attacks[BITBOARD_TEAMS];
+    uint32_t *move_counts[BITBOARD_TEAMS];
+} chess_BoardBatch;
+
+typedef enum
+{
+    chess_MATE_FOUND,
+    chess_NO_MATE,
+    chess_MATE_UNKNOWN
+} chess_MateSearchResult;
+
+/*
+Node of the proof-number search tree. Nodes live in a fixed-size pool and are linked through indices;
+free nodes are chained through next_sibling. Positions are not stored but replayed from the root.
+*/
+typedef struct
+{
+    uint32_t proof_number;
+    uint32_t disproof_number;
+    int32_t parent;
+    int32_t first_child;
+    int32_t next_sibling;
+    int8_t origin;
+    int8_t destination;
+    uint8_t ply;
+} chess_ProofNode;
+
+typedef struct
+{
+    chess_ProofNode *nodes;
+    int capacity;
+    int free_head;
+    int free_count;
+    int root_board[BOARD_SIZE];
+    chess_Team attacker;
+    int max_plies;
+    int expanded_nodes;
+    int allocated_nodes;
+    int peak_nodes;
+} chess_ProofSearch;
+
+typedef struct
+{
+    chess_MateSearchResult result;
+    chess_Move move;
+    int expanded_nodes;
+    int allocated_nodes;
+    int peak_nodes;
+    int proof_tree_size;
+    double solve_time;
+} chess_MateSearchReport;
+
+typedef enum
+{
+    chess_BOUND_EXACT,
+    chess_BOUND_LOWER,
+    chess_BOUND_UPPER
+} chess_Bound;
+
+typedef struct
+{
+    uint64_t hash;
+    int32_t score;
+    int8_t depth;
+    uint8_t bound;
+    uint8_t generation;
+    int8_t origin;
+    int8_t destination;
+} chess_TranspositionEntry;
+
+/*
+Search state that may persist across the moves of a game. If persistent is set, the transposition table
+is aged through its generation instead of being cleared, history scores are halved instead of reset,
+and killer moves and the principal variation of the previous search are kept for move ordering.
+*/
+typedef struct
+{
+    bool persistent;
+    chess_TranspositionEntry *transposition_table;
+    uint8_t generation;
+    int history[BOARD_SIZE][BOARD_SIZE];
+    chess_Move killers[SEARCH_MAX_PLY][SEARCH_KILLER_MOVES];
+    chess_Move pv[SEARCH_MAX_PLY];
+    int pv_length;
+    uint64_t expected_hash;
+    uint64_t ponder_hash;
+    int ponder_depth;
+
+    bool has_deadline;
+    clock_t deadline;
+    long max_nodes;
+    long nodes;
+    bool stopped;
+    chess_Move pv_table[SEARCH_MAX_PLY][SEARCH_MAX_PLY];
+    int pv_table_length[SEARCH_MAX_PLY];
+} chess_SearchState;
+
+typedef struct
+{
+    chess_Move move;
+    int score;
+    int depth;
+    long nodes;
+    bool ponder_hit;
+} chess_SearchResult;
+
+typedef struct
+{
+    const char *fen;
+    chess_Team team;
+    int moves;
+    chess_MateSearchResult expected_result;
+    size_t memory_limit;
+} chess_MatePuzzle;
+
 const chess_Coordinates DIAGONAL_MOVE_INDEX_OFFSETS[DIAGONAL_MOVES] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
 const chess_Coordinates KING_MOVE_INDEX_OFFSETS[INDEX_OFFSETS] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
 
-int chess_compute_zobrist_hash(int board[BOARD_SIZE]);
-int chess_update_zobrist_hash(int board[BOARD_SIZE], int index);
+// Maps board piece values to 4-bit packed piece codes; castling kings share the code of the plain king.
+const uint8_t PACKED_CODES_BY_PIECE[BLACK_KING_CASTLE + 1] = {0, 0, 1, 2, 3, 4, 5, 6, 7, 7, 8, 9, 10, 11, 12, 13, 14, 15, 15};
+const int PIECES_BY_PACKED_CODE[PACKED_PIECE_CODES] = {
+    WHITE_PAWN, WHITE_PAWN_EN_PASSANT, WHITE_ROOK, WHITE_ROOK_CASTLE, WHITE_KNIGHT, WHITE_BISHOP, WHITE_QUEEN, WHITE_KING,
+    BLACK_PAWN, BLACK_PAWN_EN_PASSANT, BLACK_ROOK, BLACK_ROOK_CASTLE, BLACK_KNIGHT, BLACK_BISHOP, BLACK_QUEEN, BLACK_KING};
+
+/*
+Precomputed targets of knights and kings for each square, terminated by LEAPER_TARGETS_END,
+so no coordinate arithmetic is needed at runtime.
+*/
+const int8_t KNIGHT_TARGETS[BOARD_SIZE][LEAPER_TARGETS] = {
+    {10, 17, -1, -1, -1, -1, -1, -1, -1},
+    {11, 16, 18, -1, -1, -1, -1, -1, -1},
+    {8, 12, 17, 19, -1, -1, -1, -1, -1},
+    {9, 13, 18, 20, -1, -1, -1, -1, -1},
+    {10, 14, 19, 21, -1, -1, -1, -1, -1},
+    {11, 15, 20, 22, -1, -1, -1, -1, -1},
+    {12, 21, 23, -1, -1, -1, -1, -1, -1},
+    {13, 22, -1, -1, -1, -1, -1, -1, -1},
+    {2, 18, 25, -1, -1, -1, -1, -1, -1},
+    {3, 19, 24, 26, -1, -1, -1, -1, -1},
+    {0, 16, 4, 20, 25, 27, -1, -1, -1},
+    {1, 17, 5, 21, 26, 28, -1, -1, -1},
+    {2, 18, 6, 22, 27, 29, -1, -1, -1},
+    {3, 19, 7, 23, 28, 30, -1, -1, -1},
+    {4, 20, 29, 31, -1, -1, -1, -1, -1},
+    {5, 21, 30, -1, -1, -1, -1, -1, -1},
+    {10, 26, 1, 33, -1, -1, -1, -1, -1},
+    {11, 27, 0, 32, 2, 34, -1, -1, -1},
+    {8, 24, 12, 28, 1, 33, 3, 35, -1},
+    {9, 25, 13, 29, 2, 34, 4, 36, -1},
+    {10, 26, 14, 30, 3, 35, 5, 37, -1},
+    {11, 27, 15, 31, 4, 36, 6, 38, -1},
+    {12, 28, 5, 37, 7, 39, -1, -1, -1},
+    {13, 29, 6, 38, -1, -1, -1, -1, -1},
+    {18, 34, 9, 41, -1, -1, -1, -1, -1},
+    {19, 35, 8, 40, 10, 42, -1, -1, -1},
+    {16, 32, 20, 36, 9, 41, 11, 43, -1},
+    {17, 33, 21, 37, 10, 42, 12, 44, -1},
+    {18, 34, 22, 38, 11, 43, 13, 45, -1},
+    {19, 35, 23, 39, 12, 44, 14, 46, -1},
+    {20, 36, 13, 45, 15, 47, -1, -1, -1},
+    {21, 37, 14, 46, -1, -1, -1, -1, -1},
+    {26, 42, 17, 49, -1, -1, -1, -1, -1},
+    {27, 43, 16, 48, 18, 50, -1, -1, -1},
+    {24, 40, 28, 44, 17, 49, 19, 51, -1},
+    {25, 41, 29, 45, 18, 50, 20, 52, -1},
+    {26, 42, 30, 46, 19, 51, 21, 53, -1},
+    {27, 43, 31, 47, 20, 52, 22, 54, -1},
+    {28, 44, 21, 53, 23, 55, -1, -1, -1},
+    {29, 45, 22, 54, -1, -1, -1, -1, -1},
+    {34, 50, 25, 57, -1, -1, -1, -1, -1},
+    {35, 51, 24, 56, 26, 58, -1, -1, -1},
+    {32, 48, 36, 52, 25, 57, 27, 59, -1},
+    {33, 49, 37, 53, 26, 58, 28, 60, -1},
+    {34, 50, 38, 54, 27, 59, 29, 61, -1},
+    {35, 51, 39, 55, 28, 60, 30, 62, -1},
+    {36, 52, 29, 61, 31, 63, -1, -1, -1},
+    {37, 53, 30, 62, -1, -1, -1, -1, -1},
+    {42, 58, 33, -1, -1, -1, -1, -1, -1},
+    {43, 59, 32, 34, -1, -1, -1, -1, -1},
+    {40, 56, 44, 60, 33, 35, -1, -1, -1},
+    {41, 57, 45, 61, 34, 36, -1, -1, -1},
+    {42, 58, 46, 62, 35, 37, -1, -1, -1},
+    {43, 59, 47, 63, 36, 38, -1, -1, -1},
+    {44, 60, 37, 39, -1, -1, -1, -1, -1},
+    {45, 61, 38, -1, -1, -1, -1, -1, -1},
+    {50, 41, -1, -1, -1, -1, -1, -1, -1},
+    {51, 40, 42, -1, -1, -1, -1, -1, -1},
+    {48, 52, 41, 43, -1, -1, -1, -1, -1},
+    {49, 53, 42, 44, -1, -1, -1, -1, -1},
+    {50, 54, 43, 45, -1, -1, -1, -1, -1},
+    {51, 55, 44, 46, -1, -1, -1, -1, -1},
+    {52, 45, 47, -1, -1, -1, -1, -1, -1},
+    {53, 46, -1, -1, -1, -1, -1, -1, -1}};
+const int8_t KING_TARGETS[BOARD_SIZE][LEAPER_TARGETS] = {
+    {8, 1, 9, -1, -1, -1, -1, -1, -1},
+    {0, 8, 9, 2, 10, -1, -1, -1, -1},
+    {1, 9, 10, 3, 11, -1, -1, -1, -1},
+    {2, 10, 11, 4, 12, -1, -1, -1, -1},
+    {3, 11, 12, 5, 13, -1, -1, -1, -1},
+    {4, 12, 13, 6, 14, -1, -1, -1, -1},
+    {5, 13, 14, 7, 15, -1, -1, -1, -1},
+    {6, 14, 15, -1, -1, -1, -1, -1, -1},
+    {0, 16, 1, 9, 17, -1, -1, -1, -1},
+    {0, 8, 16, 1, 17, 2, 10, 18, -1},
+    {1, 9, 17, 2, 18, 3, 11, 19, -1},
+    {2, 10, 18, 3, 19, 4, 12, 20, -1},
+    {3, 11, 19, 4, 20, 5, 13, 21, -1},
+    {4, 12, 20, 5, 21, 6, 14, 22, -1},
+    {5, 13, 21, 6, 22, 7, 15, 23, -1},
+    {6, 14, 22, 7, 23, -1, -1, -1, -1},
+    {8, 24, 9, 17, 25, -1, -1, -1, -1},
+    {8, 16, 24, 9, 25, 10, 18, 26, -1},
+    {9, 17, 25, 10, 26, 11, 19, 27, -1},
+    {10, 18, 26, 11, 27, 12, 20, 28, -1},
+    {11, 19, 27, 12, 28, 13, 21, 29, -1},
+    {12, 20, 28, 13, 29, 14, 22, 30, -1},
+    {13, 21, 29, 14, 30, 15, 23, 31, -1},
+    {14, 22, 30, 15, 31, -1, -1, -1, -1},
+    {16, 32, 17, 25, 33, -1, -1, -1, -1},
+    {16, 24, 32, 17, 33, 18, 26, 34, -1},
+    {17, 25, 33, 18, 34, 19, 27, 35, -1},
+    {18, 26, 34, 19, 35, 20, 28, 36, -1},
+    {19, 27, 35, 20, 36, 21, 29, 37, -1},
+    {20, 28, 36, 21, 37, 22, 30, 38, -1},
+    {21, 29, 37, 22, 38, 23, 31, 39, -1},
+    {22, 30, 38, 23, 39, -1, -1, -1, -1},
+    {24, 40, 25, 33, 41, -1, -1, -1, -1},
+    {24, 32, 40, 25, 41, 26, 34, 42, -1},
+    {25, 33, 41, 26, 42, 27, 35, 43, -1},
+    {26, 34, 42, 27, 43, 28, 36, 44, -1},
+    {27, 35, 43, 28, 44, 29, 37, 45, -1},
+    {28, 36, 44, 29, 45, 30, 38, 46, -1},
+    {29, 37, 45, 30, 46, 31, 39, 47, -1},
+    {30, 38, 46, 31, 47, -1, -1, -1, -1},
+    {32, 48, 33, 41, 49, -1, -1, -1, -1},
+    {32, 40, 48, 33, 49, 34, 42, 50, -1},
+    {33, 41, 49, 34, 50, 35, 43, 51, -1},
+    {34, 42, 50, 35, 51, 36, 44, 52, -1},
+    {35, 43, 51, 36, 52, 37, 45, 53, -1},
+    {36, 44, 52, 37, 53, 38, 46, 54, -1},
+    {37, 45, 53, 38, 54, 39, 47, 55, -1},
+    {38, 46, 54, 39, 55, -1, -1, -1, -1},
+    {40, 56, 41, 49, 57, -1, -1, -1, -1},
+    {40, 48, 56, 41, 57, 42, 50, 58, -1},
+    {41, 49, 57, 42, 58, 43, 51, 59, -1},
+    {42, 50, 58, 43, 59, 44, 52, 60, -1},
+    {43, 51, 59, 44, 60, 45, 53, 61, -1},
+    {44, 52, 60, 45, 61, 46, 54, 62, -1},
+    {45, 53, 61, 46, 62, 47, 55, 63, -1},
+    {46, 54, 62, 47, 63, -1, -1, -1, -1},
+    {48, 49, 57, -1, -1, -1, -1, -1, -1},
+    {48, 56, 49, 50, 58, -1, -1, -1, -1},
+    {49, 57, 50, 51, 59, -1, -1, -1, -1},
+    {50, 58, 51, 52, 60, -1, -1, -1, -1},
+    {51, 59, 52, 53, 61, -1, -1, -1, -1},
+    {52, 60, 53, 54, 62, -1, -1, -1, -1},
+    {53, 61, 54, 55, 63, -1, -1, -1, -1},
+    {54, 62, 55, -1, -1, -1, -1, -1, -1}};
+
+// Board index steps of the KING_MOVE_INDEX_OFFSETS directions and the number of squares to the board edge along each.
+const int RAY_INDEX_STEPS[INDEX_OFFSETS] = {-9, -1, 7, -8, 8, -7, 1, 9};
+const int8_t RAY_LENGTHS[BOARD_SIZE][INDEX_OFFSETS] = {
+    {0, 0, 0, 0, 7, 0, 7, 7},
+    {0, 1, 1, 0, 7, 0, 6, 6},
+    {0, 2, 2, 0, 7, 0, 5, 5},
+    {0, 3, 3, 0, 7, 0, 4, 4},
+    {0, 4, 4, 0, 7, 0, 3, 3},
+    {0, 5, 5, 0, 7, 0, 2, 2},
+    {0, 6, 6, 0, 7, 0, 1, 1},
+    {0, 7, 7, 0, 7, 0, 0, 0},
+    {0, 0, 0, 1, 6, 1, 7, 6},
+    {1, 1, 1, 1, 6, 1, 6, 6},
+    {1, 2, 2, 1, 6, 1, 5, 5},
+    {1, 3, 3, 1, 6, 1, 4, 4},
+    {1, 4, 4, 1, 6, 1, 3, 3},
+    {1, 5, 5, 1, 6, 1, 2, 2},
+    {1, 6, 6, 1, 6, 1, 1, 1},
+    {1, 7, 6, 1, 6, 0, 0, 0},
+    {0, 0, 0, 2, 5, 2, 7, 5},
+    {1, 1, 1, 2, 5, 2, 6, 5},
+    {2, 2, 2, 2, 5, 2, 5, 5},
+    {2, 3, 3, 2, 5, 2, 4, 4},
+    {2, 4, 4, 2, 5, 2, 3, 3},
+    {2, 5, 5, 2, 5, 2, 2, 2},
+    {2, 6, 5, 2, 5, 1, 1, 1},
+    {2, 7, 5, 2, 5, 0, 0, 0},
+    {0, 0, 0, 3, 4, 3, 7, 4},
+    {1, 1, 1, 3, 4, 3, 6, 4},
+    {2, 2, 2, 3, 4, 3, 5, 4},
+    {3, 3, 3, 3, 4, 3, 4, 4},
+    {3, 4, 4, 3, 4, 3, 3, 3},
+    {3, 5, 4, 3, 4, 2, 2, 2},
+    {3, 6, 4, 3, 4, 1, 1, 1},
+    {3, 7, 4, 3, 4, 0, 0, 0},
+    {0, 0, 0, 4, 3, 4, 7, 3},
+    {1, 1, 1, 4, 3, 4, 6, 3},
+    {2, 2, 2, 4, 3, 4, 5, 3},
+    {3, 3, 3, 4, 3, 4, 4, 3},
+    {4, 4, 3, 4, 3, 3, 3, 3},
+    {4, 5, 3, 4, 3, 2, 2, 2},
+    {4, 6, 3, 4, 3, 1, 1, 1},
+    {4, 7, 3, 4, 3, 0, 0, 0},
+    {0, 0, 0, 5, 2, 5, 7, 2},
+    {1, 1, 1, 5, 2, 5, 6, 2},
+    {2, 2, 2, 5, 2, 5, 5, 2},
+    {3, 3, 2, 5, 2, 4, 4, 2},
+    {4, 4, 2, 5, 2, 3, 3, 2},
+    {5, 5, 2, 5, 2, 2, 2, 2},
+    {5, 6, 2, 5, 2, 1, 1, 1},
+    {5, 7, 2, 5, 2, 0, 0, 0},
+    {0, 0, 0, 6, 1, 6, 7, 1},
+    {1, 1, 1, 6, 1, 6, 6, 1},
+    {2, 2, 1, 6, 1, 5, 5, 1},
+    {3, 3, 1, 6, 1, 4, 4, 1},
+    {4, 4, 1, 6, 1, 3, 3, 1},
+    {5, 5, 1, 6, 1, 2, 2, 1},
+    {6, 6, 1, 6, 1, 1, 1, 1},
+    {6, 7, 1, 6, 1, 0, 0, 0},
+    {0, 0, 0, 7, 0, 7, 7, 0},
+    {1, 1, 0, 7, 0, 6, 6, 0},
+    {2, 2, 0, 7, 0, 5, 5, 0},
+    {3, 3, 0, 7, 0, 4, 4, 0},
+    {4, 4, 0, 7, 0, 3, 3, 0},
+    {5, 5, 0, 7, 0, 2, 2, 0},
+    {6, 6, 0, 7, 0, 1, 1, 0},
+    {7, 7, 0, 7, 0, 0, 0, 0}};
+
+const chess_BitboardDirection KNIGHT_BITBOARD_DIRECTIONS[INDEX_OFFSETS] = {
+    {-17, ~BITBOARD_FILE_H}, {-15, ~BITBOARD_FILE_A}, {15, ~BITBOARD_FILE_H}, {17, ~BITBOARD_FILE_A},
+    {-10, ~(BITBOARD_FILE_G | BITBOARD_FILE_H)}, {-6, ~(BITBOARD_FILE_A | BITBOARD_FILE_B)}, {6, ~(BITBOARD_FILE_G | BITBOARD_FILE_H)}, {10, ~(BITBOARD_FILE_A | BITBOARD_FILE_B)}};
+const chess_BitboardDirection STRAIGHT_BITBOARD_DIRECTIONS[BITBOARD_LINE_DIRECTIONS] = {{-BOARD_ROW_SIZE, ~0ULL}, {BOARD_ROW_SIZE, ~0ULL}, {-1, ~BITBOARD_FILE_H}, {1, ~BITBOARD_FILE_A}};
+const chess_BitboardDirection DIAGONAL_BITBOARD_DIRECTIONS[BITBOARD_LINE_DIRECTIONS] = {{-9, ~BITBOARD_FILE_H}, {-7, ~BITBOARD_FILE_A}, {7, ~BITBOARD_FILE_H}, {9, ~BITBOARD_FILE_A}};
+const chess_BitboardDirection WHITE_PAWN_CAPTURE_BITBOARD_DIRECTIONS[2] = {{-9, ~BITBOARD_FILE_H}, {-7, ~BITBOARD_FILE_A}};
+const chess_BitboardDirection BLACK_PAWN_CAPTURE_BITBOARD_DIRECTIONS[2] = {{7, ~BITBOARD_FILE_H}, {9, ~BITBOARD_FILE_A}};
+
+// The last puzzles only fit their node pool because solved subtrees are collected, or do not fit it at all.
+const chess_MatePuzzle MATE_PUZZLES[MATE_PUZZLE_COUNT] = {
+    {"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", chess_WHITE, 1, chess_MATE_FOUND, 0},
+    {"3r2k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", chess_WHITE, 1, chess_MATE_FOUND, 0},
+    {"7k/8/8/8/8/8/R7/1R4K1 w - - 0 1", chess_WHITE, 1, chess_NO_MATE, 0},
+    {"7k/8/8/8/8/8/R7/1R4K1 w - - 0 1", chess_WHITE, 2, chess_MATE_FOUND, 0},
+    {"1r4k1/r7/8/8/8/8/8/7K b - - 0 1", chess_BLACK, 2, chess_MATE_FOUND, 0},
+    {"6k1/5ppp/8/8/8/8/5PPP/6K1 w - - 0 1", chess_WHITE, 2, chess_NO_MATE, 0},
+    {"r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - 0 1", chess_WHITE, 2, chess_NO_MATE, 0},
+    {"r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - 0 1", chess_WHITE, 3, chess_MATE_FOUND, 0},
+    {"8/8/8/8/8/1k6/8/RR4K1 w - - 0 1", chess_WHITE, 4, chess_MATE_FOUND, 0},
+    {"8/8/8/8/8/8/3k4/RR4K1 w - - 0 1", chess_WHITE, 5, chess_MATE_FOUND, 0},
+    {"8/8/8/8/8/8/3k4/RR4K1 w - - 0 1", chess_WHITE, 5, chess_MATE_FOUND, MATE_PUZZLE_SMALL_POOL_NODES * sizeof(chess_ProofNode)},
+    {"8/8/8/8/8/1k6/8/RR4K1 w - - 0 1", chess_WHITE, 4, chess_MATE_UNKNOWN, MATE_PUZZLE_TINY_POOL_NODES * sizeof(chess_ProofNode)}};
+
+// White to move in all of them.
+const char *const SELF_PLAY_POSITIONS[SELF_PLAY_POSITION_COUNT] = {
+    "",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/ppp2ppp/4pn2/3p4/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4",
+    "r2q1rk1/pp2bppp/2n1pn2/3p4/3P4/2NBPN2/PP3PPP/R2Q1RK1 w - - 0 10"};
+
+// Material values in centipawns, positive for white and negative for black pieces.
+const int PIECE_VALUES[BLACK_KING_CASTLE + 1] = {0, 100, 100, 500, 500, 320, 330, 900, 0, 0, -100, -100, -500, -500, -320, -330, -900, 0, 0};
+
+chess_error_code chess_init_board_from_fen(int board[BOARD_SIZE], const char string[]);
+uint64_t chess_compute_zobrist_hash(const int board[BOARD_SIZE], const chess_Team team);